@@ -0,0 +1,252 @@
+#ifndef AFFINE_HPP
+# define AFFINE_HPP
+
+# include <cmath>
+# include <iostream>
+# include <iomanip>
+# include "Mat4.hpp"
+# include "Vec3.hpp"
+
+/*
+** Affine transform stored as the top three rows of a column-major 4x4
+** matrix, the implicit last row being (0, 0, 0, 1):
+**
+**	val[0]	val[3]	val[6]	val[9]
+**	val[1]	val[4]	val[7]	val[10]
+**	val[2]	val[5]	val[8]	val[11]
+**	0		0		0		1
+**
+** Composition costs 36 multiplications instead of 64, and inverse() only
+** inverts the 3x3 part. Convert with toMat4() when uploading to GL.
+*/
+template<typename TYPE>
+class Affine
+{
+public:
+	TYPE		val[12];
+
+	constexpr Affine(void) : val{1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0}
+	{
+	}
+
+	/* values in memory order, columns first, translation last */
+	constexpr Affine(TYPE const &v0, TYPE const &v1, TYPE const &v2,
+					TYPE const &v3, TYPE const &v4, TYPE const &v5,
+					TYPE const &v6, TYPE const &v7, TYPE const &v8,
+					TYPE const &v9, TYPE const &v10, TYPE const &v11)
+		: val{v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11}
+	{
+	}
+
+	/* drops the last row of m, which must be (0, 0, 0, 1) */
+	explicit constexpr Affine(Mat4<TYPE> const &m)
+		: val{m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10], m[12], m[13], m[14]}
+	{
+	}
+
+	static constexpr Affine<TYPE>
+	identity(void)
+	{
+		return (Affine<TYPE>());
+	}
+
+	static constexpr Affine<TYPE>
+	translation(TYPE const &x, TYPE const &y, TYPE const &z)
+	{
+		return (Affine<TYPE>(1, 0, 0, 0, 1, 0, 0, 0, 1, x, y, z));
+	}
+
+	static constexpr Affine<TYPE>
+	scaling(TYPE const &x, TYPE const &y, TYPE const &z)
+	{
+		return (Affine<TYPE>(x, 0, 0, 0, y, 0, 0, 0, z, 0, 0, 0));
+	}
+
+	/* angle in radians, the axis does not need to be normalized */
+	template<typename MATH = PreciseMath>
+	static Affine<TYPE>
+	rotation(TYPE const &angle, TYPE x, TYPE y, TYPE z)
+	{
+		TYPE		s;
+		TYPE		c;
+		TYPE		oc;
+		TYPE const	h = MATH::rsqrt(x * x + y * y + z * z);
+
+		MATH::sincos(angle, s, c);
+		oc = 1 - c;
+		x *= h;
+		y *= h;
+		z *= h;
+		return (Affine<TYPE>(oc * x * x + c, oc * x * y - z * s, oc * z * x + y * s,
+							oc * x * y + z * s, oc * y * y + c, oc * y * z - x * s,
+							oc * z * x - y * s, oc * y * z + x * s, oc * z * z + c,
+							0, 0, 0));
+	}
+
+	constexpr Mat4<TYPE>
+	toMat4(void) const
+	{
+		return (Mat4<TYPE>(val[0], val[1], val[2], 0,
+							val[3], val[4], val[5], 0,
+							val[6], val[7], val[8], 0,
+							val[9], val[10], val[11], 1));
+	}
+
+	constexpr Vec3<TYPE>
+	transformPoint(Vec3<TYPE> const &p) const
+	{
+		return (Vec3<TYPE>(val[0] * p.x + val[3] * p.y + val[6] * p.z + val[9],
+							val[1] * p.x + val[4] * p.y + val[7] * p.z + val[10],
+							val[2] * p.x + val[5] * p.y + val[8] * p.z + val[11]));
+	}
+
+	constexpr Vec3<TYPE>
+	transformVector(Vec3<TYPE> const &v) const
+	{
+		return (Vec3<TYPE>(val[0] * v.x + val[3] * v.y + val[6] * v.z,
+							val[1] * v.x + val[4] * v.y + val[7] * v.z,
+							val[2] * v.x + val[5] * v.y + val[8] * v.z));
+	}
+
+	constexpr TYPE
+	determinant(void) const
+	{
+		return (val[0] * (val[4] * val[8] - val[7] * val[5])
+				- val[3] * (val[1] * val[8] - val[7] * val[2])
+				+ val[6] * (val[1] * val[5] - val[4] * val[2]));
+	}
+
+	/*
+	** General affine inverse: invert the 3x3 part with cofactors, then
+	** t' = -L^-1 * t. Returns false and leaves res untouched if singular.
+	*/
+	bool
+	inverse(Affine<TYPE> &res) const
+	{
+		TYPE const	det = determinant();
+		TYPE		inv;
+		TYPE		l[9];
+
+		if (det == 0)
+			return (false);
+		inv = 1 / det;
+		l[0] = (val[4] * val[8] - val[7] * val[5]) * inv;
+		l[1] = (val[7] * val[2] - val[1] * val[8]) * inv;
+		l[2] = (val[1] * val[5] - val[4] * val[2]) * inv;
+		l[3] = (val[6] * val[5] - val[3] * val[8]) * inv;
+		l[4] = (val[0] * val[8] - val[6] * val[2]) * inv;
+		l[5] = (val[3] * val[2] - val[0] * val[5]) * inv;
+		l[6] = (val[3] * val[7] - val[6] * val[4]) * inv;
+		l[7] = (val[6] * val[1] - val[0] * val[7]) * inv;
+		l[8] = (val[0] * val[4] - val[3] * val[1]) * inv;
+		res = Affine<TYPE>(l[0], l[1], l[2], l[3], l[4], l[5], l[6], l[7], l[8],
+						-(l[0] * val[9] + l[3] * val[10] + l[6] * val[11]),
+						-(l[1] * val[9] + l[4] * val[10] + l[7] * val[11]),
+						-(l[2] * val[9] + l[5] * val[10] + l[8] * val[11]));
+		return (true);
+	}
+
+	/*
+	** Inverse of a rotation + translation (orthonormal 3x3 part):
+	** transpose the rotation, t' = -R^T * t. Wrong if there is any scale.
+	*/
+	constexpr Affine<TYPE>
+	rigidInverse(void) const
+	{
+		return (Affine<TYPE>(val[0], val[3], val[6],
+							val[1], val[4], val[7],
+							val[2], val[5], val[8],
+							-(val[0] * val[9] + val[1] * val[10] + val[2] * val[11]),
+							-(val[3] * val[9] + val[4] * val[10] + val[5] * val[11]),
+							-(val[6] * val[9] + val[7] * val[10] + val[8] * val[11])));
+	}
+
+	/*
+	** Normal matrix, the inverse transpose of the 3x3 part, written as a
+	** column-major 3x3 matrix (glUniformMatrix3fv layout). The cofactor
+	** matrix is used without dividing by the determinant's magnitude, as
+	** normals are renormalized anyway; only its sign is kept so mirrored
+	** transforms do not flip normals. Returns false if singular.
+	*/
+	bool
+	normalMatrix(TYPE *out) const
+	{
+		TYPE const	det = determinant();
+		TYPE const	sign = det < 0 ? -1 : 1;
+
+		if (det == 0)
+			return (false);
+		out[0] = (val[4] * val[8] - val[7] * val[5]) * sign;
+		out[1] = (val[6] * val[5] - val[3] * val[8]) * sign;
+		out[2] = (val[3] * val[7] - val[6] * val[4]) * sign;
+		out[3] = (val[7] * val[2] - val[1] * val[8]) * sign;
+		out[4] = (val[0] * val[8] - val[6] * val[2]) * sign;
+		out[5] = (val[6] * val[1] - val[0] * val[7]) * sign;
+		out[6] = (val[1] * val[5] - val[4] * val[2]) * sign;
+		out[7] = (val[3] * val[2] - val[0] * val[5]) * sign;
+		out[8] = (val[0] * val[4] - val[3] * val[1]) * sign;
+		return (true);
+	}
+
+	Affine<TYPE>
+	operator*(Affine<TYPE> const &rhs) const
+	{
+		TYPE const	*a = this->val;
+		TYPE const	*b = rhs.val;
+
+		return (Affine<TYPE>(a[0] * b[0] + a[3] * b[1] + a[6] * b[2],
+							a[1] * b[0] + a[4] * b[1] + a[7] * b[2],
+							a[2] * b[0] + a[5] * b[1] + a[8] * b[2],
+							a[0] * b[3] + a[3] * b[4] + a[6] * b[5],
+							a[1] * b[3] + a[4] * b[4] + a[7] * b[5],
+							a[2] * b[3] + a[5] * b[4] + a[8] * b[5],
+							a[0] * b[6] + a[3] * b[7] + a[6] * b[8],
+							a[1] * b[6] + a[4] * b[7] + a[7] * b[8],
+							a[2] * b[6] + a[5] * b[7] + a[8] * b[8],
+							a[0] * b[9] + a[3] * b[10] + a[6] * b[11] + a[9],
+							a[1] * b[9] + a[4] * b[10] + a[7] * b[11] + a[10],
+							a[2] * b[9] + a[5] * b[10] + a[8] * b[11] + a[11]));
+	}
+
+	Affine<TYPE> &
+	operator*=(Affine<TYPE> const &rhs)
+	{
+		*this = *this * rhs;
+		return (*this);
+	}
+};
+
+/*
+** Full matrix times affine matrix, the implicit last row of rhs saves a
+** quarter of the multiplications (48 instead of 64).
+*/
+template<typename TYPE>
+Mat4<TYPE>
+operator*(Mat4<TYPE> const &lhs, Affine<TYPE> const &rhs)
+{
+	Mat4<TYPE>		res;
+	TYPE const		*a = lhs.val;
+	TYPE const		*b = rhs.val;
+	int				i;
+
+	i = 0;
+	while (i < 4)
+	{
+		res.val[i] = a[i] * b[0] + a[4 + i] * b[1] + a[8 + i] * b[2];
+		res.val[4 + i] = a[i] * b[3] + a[4 + i] * b[4] + a[8 + i] * b[5];
+		res.val[8 + i] = a[i] * b[6] + a[4 + i] * b[7] + a[8 + i] * b[8];
+		res.val[12 + i] = a[i] * b[9] + a[4 + i] * b[10] + a[8 + i] * b[11] + a[12 + i];
+		++i;
+	}
+	return (res);
+}
+
+template<typename TYPE>
+std::ostream &
+operator<<(std::ostream &o, Affine<TYPE> const &mat)
+{
+	o << mat.toMat4();
+	return (o);
+}
+
+#endif
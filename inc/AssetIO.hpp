@@ -0,0 +1,134 @@
+#ifndef ASSETIO_HPP
+# define ASSETIO_HPP
+
+# include <functional>
+# include <mutex>
+# include <condition_variable>
+# include <set>
+# include <thread>
+# include <unordered_map>
+# include <vector>
+# include <stdint.h>
+# include <sys/types.h>
+# include <sys/uio.h>
+# include "ThreadPool.hpp"
+
+/*
+** io_uring is used when the kernel headers have it, unless built with
+** -DASSET_IO_NO_URING; init() still falls back to the pool when the
+** running kernel refuses it.
+*/
+# if defined(__linux__) && !defined(ASSET_IO_NO_URING) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   define ASSET_IO_URING
+#  endif
+# endif
+
+/* reads in flight on the ring, which has twice as many entries for cancels */
+# define ASSET_IO_DEPTH			(64)
+
+/*
+** Asynchronous reads into caller buffers:
+**
+**	- with io_uring, reads are batched on one ring and a reaper thread
+**	  collects their completions;
+**	- otherwise each read is a blocking pread() on the ThreadPool, at most
+**	  half the workers at a time so decoding keeps going.
+**
+** Queued reads start highest priority first, in request order within a
+** priority, at most ASSET_IO_DEPTH (or the pool limit) at a time.
+** Completions run on the reaper or on the worker: they must be short and
+** hand the data to the next stage, typically by submitting a task to the
+** pool. Every read completes exactly once, with the byte count (short at
+** the end of the file) or -errno, -ECANCELED once canceled. The buffer
+** belongs to the service until then.
+*/
+class AssetIO
+{
+public:
+	typedef uint64_t					Ticket;
+	typedef std::function<void(ssize_t const &)>	Completion;
+
+	AssetIO(ThreadPool &pool);
+	~AssetIO(void);
+
+	/* 1 with io_uring, 0 on the pool */
+	int									init(void);
+	Ticket								read(int const &fd, void *buffer, size_t const &size,
+											uint64_t const &offset, int const &priority,
+											Completion const &done);
+	/* false if the read already completed */
+	bool								cancel(Ticket const &ticket);
+	/* waits for every read, completions included */
+	void								finish(void);
+	size_t								pending(void);
+	bool								uring(void) const;
+
+private:
+	struct Request
+	{
+		Ticket							ticket;
+		int								priority;
+		int								fd;
+		unsigned char *					buffer;
+		size_t							size;
+		uint64_t						offset;
+		/* bytes read so far, a short read is resumed */
+		size_t							done;
+		bool							canceled;
+		struct iovec					iov;
+		Completion						completion;
+	};
+
+	struct Order
+	{
+		bool							operator()(Request const *a, Request const *b) const;
+	};
+
+	typedef std::vector<std::pair<Request *, ssize_t> >	Finished;
+
+	ThreadPool &						pool;
+	std::mutex							mutex;
+	std::condition_variable				cond;
+	std::set<Request *, Order>			queued;
+	std::unordered_map<Ticket, Request *>	requests;
+	Ticket								next;
+	size_t								active;
+	size_t								depth;
+	/* reads whose completion has not returned yet */
+	size_t								outstanding;
+
+	int									ringFd;
+	void *								sqRing;
+	void *								cqRing;
+	size_t								sqRingSize;
+	size_t								cqRingSize;
+	size_t								sqesSize;
+	void *								sqes;
+	unsigned *							sqHead;
+	unsigned *							sqTail;
+	unsigned *							sqMask;
+	unsigned *							sqArray;
+	unsigned *							cqHead;
+	unsigned *							cqTail;
+	unsigned *							cqMask;
+	void *								cqes;
+	std::thread							reaper;
+
+	int									setupRing(void);
+	void								closeRing(void);
+	void								prepare(Request *request, uint64_t const &data);
+	void								flush(Finished &finished);
+	void								reap(void);
+	void								dispatch(Finished &finished);
+	void								start(Request *request);
+	void								run(Request *request);
+	void								complete(Request *request, ssize_t const &result,
+												Finished &finished);
+	void								deliver(Finished &finished);
+
+	AssetIO(AssetIO const &src);
+	AssetIO &							operator=(AssetIO const &rhs);
+};
+
+#endif
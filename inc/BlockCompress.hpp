@@ -0,0 +1,34 @@
+#ifndef BLOCKCOMPRESS_HPP
+# define BLOCKCOMPRESS_HPP
+
+# include <cstddef>
+# include <stdint.h>
+
+/*
+** BC1 (DXT1) and BC3 (DXT5) encoders for 8-bit RGBA images. Blocks are
+** written in image memory order, 4x4 pixels each, partial blocks on the
+** right and last edges repeating the last column or row.
+**
+** Endpoints come from the principal axis of the block colors, refined
+** once by least squares; each pixel then takes the nearest of the four
+** palette colors (SSE2 when available). Single-threaded: cooks already
+** run one per ThreadPool worker.
+*/
+
+# define BC1_BLOCK_SIZE			(8)
+# define BC3_BLOCK_SIZE			(16)
+
+/* block is 16 RGBA pixels, row by row */
+void			bc1Block(unsigned char const *block, unsigned char *out);
+void			bc3Block(unsigned char const *block, unsigned char *out);
+
+size_t			bcSize(uint32_t const &width, uint32_t const &height, size_t const &blockSize);
+/* alpha ignored, opaque result */
+void			bc1Compress(unsigned char const *rgba, uint32_t const &width,
+							uint32_t const &height, unsigned char *out);
+void			bc3Compress(unsigned char const *rgba, uint32_t const &width,
+							uint32_t const &height, unsigned char *out);
+/* true if every alpha is 255, BC1 is then enough */
+bool			bcOpaque(unsigned char const *rgba, size_t const &count);
+
+#endif
@@ -3,24 +3,34 @@
 
 # include <iostream>
 # include <string>
+# include <functional>
 # include <stdint.h>
 # include <unistd.h>
 # include <cstdlib>
+# include <cstring>
 # include <fcntl.h>
+# include "MappedFile.hpp"
 
 # define FILE_E1				("Error opening file")
 # define HEADER_E1				("Error reading bmp header")
 # define HEADER_E2				("Bad BMP header!")
 # define HEADER_E3				("Error reading dib header")
 # define COMPRESSION_E1			("Unsupported compression method!")
-# define BPP_E1					("BMP must have 24 bpp!")
+# define BPP_E1					("Unsupported bpp for this compression method!")
 # define MALLOC_E1				("Failed to allocate BMP image")
 # define DATA_E1				("Failed to read BMP data")
 # define DATA_E2				("Failed to read data padding")
+# define MASK_E1				("Bad BMP channel masks!")
+# define PALETTE_E1				("Bad BMP palette!")
+# define RLE_E1					("RLE images can only be decoded whole")
 # define BMP_HSIZE				(14)
 # define DIB_HSIZE				(40)
 
 # define CMP_MAX				(14)
+/* width and height limit, in pixels */
+# define BMP_MAX_SIZE			(1 << 16)
+/* RLE pixels per byte of data at most, a run pair covers 255 in 2 bytes */
+# define BMP_RLE_RATIO			(255)
 
 # define BI_RGB					(0)
 # define BI_RLE8				(1)
@@ -36,7 +46,6 @@
 class Bmp
 {
 public:
-	int					fd;
 	unsigned char		bmp_header[BMP_HSIZE];
 	uint32_t			bmp_size;
 	uint32_t			data_offset;
@@ -46,17 +55,91 @@ public:
 	uint32_t			bpp;
 	uint32_t			compression;
 	uint32_t			raw_bmp_size;
+	/* rows stored top row first (negative height in the file) */
+	bool				top_down;
+	/* R, G, B, A masks for 16 and 32 bpp, alpha 0 if absent */
+	uint32_t			masks[4];
+	/* RGBA colors for 1, 4 and 8 bpp, as 32-bit words in memory order */
+	uint32_t			palette[256];
+	uint32_t			colors;
+	/* width * height RGBA pixels, bottom row first */
 	unsigned char *		data;
 
+	/* whole file, a read-only view of file between openFile() and closeFile() */
+	unsigned char const	*map;
+	size_t				map_size;
+
 	Bmp(void);
 	~Bmp(void);
 
 	int					load(char const *filename);
 
+	/*
+	** load() in three steps, so rows of a large image can be decoded by
+	** several threads: openFile() maps the file, validates the headers
+	** and allocates data, writeData() can then run concurrently on
+	** disjoint row ranges, closeFile() unmaps.
+	*/
+	int					openFile(char const *filename);
+	/* openFile() on a new[] buffer holding the whole file, which it now owns */
+	int					openBuffer(unsigned char *bytes, size_t const &size);
+	int					writeData(uint32_t const &first, uint32_t const &count);
+	void				closeFile(void);
+
+	/* first row (bottom row 0), row count, count * width RGBA pixels */
+	typedef std::function<int(uint32_t const &, uint32_t const &,
+								unsigned char const *)>		BandCallback;
+
+	/*
+	** Streams the image in bands of band_rows rows instead of decoding it
+	** into data, for images too large to hold. data is left untouched.
+	*/
+	int					stream(char const *filename, uint32_t const &band_rows,
+								BandCallback const &callback);
+	/* RLE rows depend on the previous ones, writeData() then takes all rows */
+	bool				sequential(void) const;
+
 	Bmp &				operator=(Bmp const &rhs);
 private:
+	/*
+	** Per channel lookup: (pixel >> shift) & mask indexes scale, which
+	** expands the channel width to 8 bits. Channels wider than 8 bits
+	** keep their top 8 bits.
+	*/
+	struct Channel
+	{
+		uint32_t		shift;
+		uint32_t		mask;
+		unsigned char	scale[256];
+	};
+
+	/* RLE decoder position, carried from one band to the next */
+	struct Rle
+	{
+		unsigned char const	*p;
+		uint32_t		x;
+		uint32_t		y;
+	};
+
+	Channel				channels[4];
+	/* 32 bpp with byte aligned 8-bit masks: source byte of each channel */
+	unsigned char		order[4];
+	bool				byte_aligned;
+
 	int					getBmpInfo(void);
-	int					writeData(void);
+	int					readMasks(void);
+	int					readPalette(void);
+	void				decodeRow(unsigned char const *row, unsigned char *out) const;
+	void				decodeIndexed(unsigned char const *row, unsigned char *out) const;
+	void				decodeMasked(unsigned char const *row, unsigned char *out) const;
+	void				decodeRle(Rle &rle, uint32_t const &first, uint32_t const &count,
+								unsigned char *out) const;
+	void				decodeRows(uint32_t const &first, uint32_t const &count,
+								unsigned char *out) const;
+	MappedFile			file;
+
+	int					mapFile(char const *filename);
+	int					readHeaders(void);
 	int					error(char const *s);
 	int					compressionSupported();
 
@@ -6,6 +6,19 @@
 # include "Mat4Stack.hpp"
 # include "Utils.hpp"
 # include "Bmp.hpp"
+# include "ThreadPool.hpp"
+# include "AssetIO.hpp"
+# include "TextureStreamer.hpp"
+# include "TextureLoader.hpp"
+# include "TextureCache.hpp"
+# include "VirtualTexture.hpp"
+# include "ShaderPermutations.hpp"
+
+# define VERTEX_SHADER				("./shaders/vertex_shader.gls")
+# define FRAGMENT_SHADER			("./shaders/fragment_shader.gls")
+
+/* decoded images handed to the streamer per frame */
+# define TEXTURE_UPLOADS_PER_FRAME	(4)
 
 class Core
 {
@@ -15,9 +28,9 @@ public:
 	int						windowWidth;
 	int						windowHeight;
 
-	/* shaders */
-	GLuint					vertexShader;
-	GLuint					fragmentShader;
+	/* shaders, program is the default variant */
+	ProgramCache			programCache;
+	ShaderPermutations		shaders;
 	GLuint					program;
 
 	/* matrices */
@@ -41,6 +54,14 @@ public:
 
 	std::ostringstream		oss_ticks;
 
+	/* workers, asynchronous reads, texture decoding and streaming */
+	ThreadPool				pool;
+	AssetIO					assetIO;
+	TextureStreamer			streamer;
+	TextureLoader			textures;
+	TextureCache			textureCache;
+	VirtualTexture			virtualTexture;
+
 	Core(void);
 	~Core(void);
 
@@ -52,6 +73,8 @@ public:
 
 	/* textures */
 	GLuint					loadTexture(char const *filename);
+	void					releaseTexture(GLuint const &texture);
+	int						loadVirtualTexture(char const *filename);
 
 	/* matrices */ 
 	void					setViewMatrix(Mat4<float> &view, Vec3<float> const &dir,
@@ -62,11 +85,6 @@ public:
 
 	/* shaders */
 	void					getLocations(void);
-	int						compileShader(GLuint shader, char const *filename);
-	GLuint					loadShader(GLenum type, char const *filename);
-	int						loadShaders(void);
-	int						linkProgram(GLuint &p);
-	void					deleteShaders(void);
 	int						initShaders(void);
 
 	/* tests */
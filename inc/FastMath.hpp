@@ -0,0 +1,169 @@
+#ifndef FASTMATH_HPP
+# define FASTMATH_HPP
+
+# include <cmath>
+# include <cstring>
+# include <stdint.h>
+# include "Simd.hpp"
+
+/*
+** Math policies, passed as a template parameter to the functions that
+** normalize or build rotations (Vec3::normalize, Mat4::setRotation, ...):
+**
+**	v.normalize();					// PreciseMath, libm
+**	v.normalize<FastMath>();		// approximations below
+**
+** FastMath error bounds, measured over the whole float range for rsqrt
+** and over |x| <= 8192 for sincos:
+**	rsqrt		relative error < 5e-7 with SSE (rsqrtss + one Newton step),
+**				< 5e-6 without SSE (bit trick + two Newton steps)
+**	sin, cos	absolute error < 2e-7 for |x| <= 8192, degrading linearly
+**				with |x| beyond that (range reduction in single precision)
+** Double precision arguments always go through libm.
+*/
+
+# define FASTMATH_PI_2_HI		(1.5703125f)
+# define FASTMATH_PI_2_LO		(4.837512969970703125e-4f)
+# define FASTMATH_PI_2_LO2		(7.54978995489188216e-8f)
+# define FASTMATH_2_PI			(0.636619772367581343f)
+
+/* 1 / sqrt(x) */
+
+inline float
+fastRsqrt(float const &x)
+{
+# if defined(SIMD_SSE2)
+	__m128 const	v = _mm_set_ss(x);
+	__m128			y;
+
+	y = _mm_rsqrt_ss(v);
+	y = _mm_mul_ss(_mm_mul_ss(_mm_set_ss(0.5f), y),
+				_mm_sub_ss(_mm_set_ss(3.0f), _mm_mul_ss(_mm_mul_ss(v, y), y)));
+	return (_mm_cvtss_f32(y));
+# else
+	uint32_t		i;
+	float			y;
+
+	std::memcpy(&i, &x, sizeof(i));
+	i = 0x5f375a86 - (i >> 1);
+	std::memcpy(&y, &i, sizeof(y));
+	y = y * (1.5f - 0.5f * x * y * y);
+	y = y * (1.5f - 0.5f * x * y * y);
+	return (y);
+# endif
+}
+
+# if defined(SIMD_SSE2)
+inline __m128
+fastRsqrt4(__m128 const &x)
+{
+	__m128 const	y = _mm_rsqrt_ps(x);
+
+	return (_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y),
+					_mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(x, y), y))));
+}
+# endif
+
+# if defined(SIMD_AVX)
+inline __m256
+fastRsqrt8(__m256 const &x)
+{
+	__m256 const	y = _mm256_rsqrt_ps(x);
+
+	return (_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y),
+						_mm256_sub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(_mm256_mul_ps(x, y), y))));
+}
+# endif
+
+/*
+** sin and cos together: reduce x to r in [-pi/4, pi/4] with a three part
+** pi/2 (Cody-Waite), evaluate both minimax polynomials on r, then pick and
+** negate according to the quadrant.
+*/
+inline void
+fastSinCos(float const &x, float &s, float &c)
+{
+	float const		q = std::floor(x * FASTMATH_2_PI + 0.5f);
+	int const		quadrant = (int)q & 3;
+	float const		r = ((x - q * FASTMATH_PI_2_HI) - q * FASTMATH_PI_2_LO) - q * FASTMATH_PI_2_LO2;
+	float const		r2 = r * r;
+	float const		ps = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+	float const		pc = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f
+						+ r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+	if (quadrant == 0)
+	{
+		s = ps;
+		c = pc;
+	}
+	else if (quadrant == 1)
+	{
+		s = pc;
+		c = -ps;
+	}
+	else if (quadrant == 2)
+	{
+		s = -ps;
+		c = -pc;
+	}
+	else
+	{
+		s = -pc;
+		c = ps;
+	}
+}
+
+/* policies */
+
+class PreciseMath
+{
+public:
+	template<typename TYPE>
+	static TYPE
+	rsqrt(TYPE const &x)
+	{
+		return (1 / sqrt(x));
+	}
+
+	template<typename TYPE>
+	static void
+	sincos(TYPE const &x, TYPE &s, TYPE &c)
+	{
+		s = sin(x);
+		c = cos(x);
+	}
+};
+
+class FastMath
+{
+public:
+	template<typename TYPE>
+	static TYPE
+	rsqrt(TYPE const &x)
+	{
+		return (PreciseMath::rsqrt(x));
+	}
+
+	template<typename TYPE>
+	static void
+	sincos(TYPE const &x, TYPE &s, TYPE &c)
+	{
+		PreciseMath::sincos(x, s, c);
+	}
+};
+
+template<>
+inline float
+FastMath::rsqrt<float>(float const &x)
+{
+	return (fastRsqrt(x));
+}
+
+template<>
+inline void
+FastMath::sincos<float>(float const &x, float &s, float &c)
+{
+	fastSinCos(x, s, c);
+}
+
+#endif
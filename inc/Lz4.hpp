@@ -0,0 +1,24 @@
+#ifndef LZ4_HPP
+# define LZ4_HPP
+
+# include <cstddef>
+
+/*
+** LZ4 block format (no frame header, no checksum), compatible with the
+** reference LZ4_compress_default / LZ4_decompress_safe. The compressor is
+** the plain greedy single-hash-table one: fast rather than tight.
+*/
+
+/* worst case compressed size of n bytes */
+size_t			lz4Bound(size_t const &n);
+/* returns the compressed size, 0 if capacity < lz4Bound(size) */
+size_t			lz4Compress(unsigned char const *src, size_t const &size,
+							unsigned char *dst, size_t const &capacity);
+/*
+** Decompresses exactly dstSize bytes. Returns 0 on malformed input or if
+** the output size does not match, never reads or writes out of bounds.
+*/
+int				lz4Decompress(unsigned char const *src, size_t const &srcSize,
+							unsigned char *dst, size_t const &dstSize);
+
+#endif
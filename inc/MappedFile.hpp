@@ -0,0 +1,61 @@
+#ifndef MAPPEDFILE_HPP
+# define MAPPEDFILE_HPP
+
+# include <cstddef>
+
+/* access hints for open(), passed on to madvise() */
+# define MAPPED_SEQUENTIAL		(1)
+# define MAPPED_WILLNEED		(2)
+/* only the file on disk, not a mounted pack entry of that name */
+# define MAPPED_NO_PACK			(4)
+/* first read buffer when the file cannot be mapped, doubled as needed */
+# define MAPPED_READ_CHUNK		(1 << 20)
+
+/*
+** Read-only view of a whole file. The file is mapped, so nothing is copied
+** and untouched pages are never read; when it cannot be (empty file, pipe,
+** filesystem without mmap) it is read in large chunks instead.
+** Names found in a mounted Pack are served from it without touching the
+** disk: a view into the pack mapping, or the entry decompressed.
+** The view stays valid until close() or destruction.
+*/
+class MappedFile
+{
+public:
+	MappedFile(void);
+	~MappedFile(void);
+
+	int						open(char const *filename, int const &hints);
+	/* takes a new[] buffer holding a whole file, as if it had been read */
+	void					adopt(unsigned char *buffer, size_t const &size);
+	void					close(void);
+	/*
+	** Drops the whole pages in [from, to) of a mapping, touching them
+	** again reads the file. Does nothing on a read or decompressed file.
+	*/
+	void					release(size_t const &from, size_t const &to);
+
+	unsigned char const *	data(void) const;
+	size_t					size(void) const;
+
+private:
+	enum Storage
+	{
+		READ,
+		MAPPED,
+		PACKED
+	};
+
+	unsigned char *			bytes;
+	size_t					length;
+	Storage					storage;
+
+	int						read(int const &fd);
+	int						openPacked(char const *filename, int const &hints);
+	void					advise(size_t const &from, size_t const &to, int const &advice);
+
+	MappedFile(MappedFile const &src);
+	MappedFile &			operator=(MappedFile const &rhs);
+};
+
+#endif
@@ -8,27 +8,189 @@
 # include <cmath>
 # include <iostream>
 # include <iomanip>
+# include "Simd.hpp"
+# include "FastMath.hpp"
 
+/*
+** res = a * b, column-major. Generic scalar path, used for every TYPE
+** without a dedicated specialization below. res must not alias a or b.
+*/
 template<typename TYPE>
-class Mat4
+inline void
+mat4Multiply(TYPE *res, TYPE const *a, TYPE const *b)
 {
-public:
-	TYPE		val[16];
+	int			i;
+	int			j;
+	int			k;
 
-	Mat4()
+	i = 0;
+	while (i < 4)
 	{
-		int		i;
+		j = 0;
+		while (j < 4)
+		{
+			res[j * 4 + i] = 0;
+			k = 0;
+			while (k < 4)
+			{
+				res[j * 4 + i] += a[k * 4 + i] * b[j * 4 + k];
+				k++;
+			}
+			j++;
+		}
+		i++;
+	}
+}
+
+# if defined(SIMD_DISPATCH)
+/*
+** AVX and FMA version of the single precision path below, two result
+** columns per iteration. Used by it when the compiler targets both, and
+** by the batch kernels when the CPU has them (Mat4Batch.cpp).
+*/
+SIMD_TARGET("avx,fma") inline void
+mat4MultiplyAvx(float *res, float const *a, float const *b)
+{
+	__m256 const	a0 = _mm256_broadcast_ps((__m128 const *)(a + 0));
+	__m256 const	a1 = _mm256_broadcast_ps((__m128 const *)(a + 4));
+	__m256 const	a2 = _mm256_broadcast_ps((__m128 const *)(a + 8));
+	__m256 const	a3 = _mm256_broadcast_ps((__m128 const *)(a + 12));
+	__m256			col;
+	__m256			r;
+	int				j;
+
+	j = 0;
+	while (j < 16)
+	{
+		col = _mm256_loadu_ps(b + j);
+		r = _mm256_mul_ps(a0, _mm256_shuffle_ps(col, col, 0x00));
+		r = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(col, col, 0x55), r);
+		r = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(col, col, 0xAA), r);
+		r = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(col, col, 0xFF), r);
+		_mm256_storeu_ps(res + j, r);
+		j += 8;
+	}
+}
+# endif
+
+/*
+** Single precision path: every column of the result is a linear combination
+** of the columns of a, weighted by the matching column of b.
+** Both vector versions read a fully before writing, and each column of b
+** before writing the same column of res, so res may alias a or b.
+*/
+template<>
+inline void
+mat4Multiply<float>(float *res, float const *a, float const *b)
+{
+# if defined(SIMD_DISPATCH) && defined(SIMD_AVX) && defined(SIMD_FMA)
+	mat4MultiplyAvx(res, a, b);
+# elif defined(SIMD_SSE2)
+	__m128 const	a0 = _mm_loadu_ps(a + 0);
+	__m128 const	a1 = _mm_loadu_ps(a + 4);
+	__m128 const	a2 = _mm_loadu_ps(a + 8);
+	__m128 const	a3 = _mm_loadu_ps(a + 12);
+	__m128			col;
+	__m128			r;
+	int				j;
+
+	j = 0;
+	while (j < 16)
+	{
+		col = _mm_loadu_ps(b + j);
+		r = _mm_mul_ps(a0, _mm_shuffle_ps(col, col, 0x00));
+		r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(col, col, 0x55)));
+		r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(col, col, 0xAA)));
+		r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(col, col, 0xFF)));
+		_mm_storeu_ps(res + j, r);
+		j += 4;
+	}
+# else
+	float			tmp[16];
+	int				i;
+	int				j;
 
+	j = 0;
+	while (j < 4)
+	{
 		i = 0;
-		while (i < 16)
+		while (i < 4)
 		{
-			this->val[i] = 0;
+			tmp[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1]
+				+ a[8 + i] * b[j * 4 + 2] + a[12 + i] * b[j * 4 + 3];
 			i++;
 		}
+		j++;
+	}
+	i = -1;
+	while (i++, i < 16)
+		res[i] = tmp[i];
+# endif
+}
+
+template<typename TYPE>
+class Mat4
+{
+public:
+	alignas(SIMD_ALIGN) TYPE	val[16];
+
+	constexpr Mat4(void) : val{}
+	{
+	}
+
+	/*
+	** Values in memory order, which is column-major:
+	** the first four values are the first column.
+	*/
+	constexpr Mat4(TYPE const &v0, TYPE const &v1, TYPE const &v2, TYPE const &v3,
+					TYPE const &v4, TYPE const &v5, TYPE const &v6, TYPE const &v7,
+					TYPE const &v8, TYPE const &v9, TYPE const &v10, TYPE const &v11,
+					TYPE const &v12, TYPE const &v13, TYPE const &v14, TYPE const &v15)
+		: val{v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15}
+	{
+	}
+
+	/* compile-time factories */
+
+	static constexpr Mat4<TYPE>
+	identity(void)
+	{
+		return (Mat4<TYPE>(1, 0, 0, 0,
+							0, 1, 0, 0,
+							0, 0, 1, 0,
+							0, 0, 0, 1));
+	}
+
+	static constexpr Mat4<TYPE>
+	translation(TYPE const &x, TYPE const &y, TYPE const &z)
+	{
+		return (Mat4<TYPE>(1, 0, 0, 0,
+							0, 1, 0, 0,
+							0, 0, 1, 0,
+							x, y, z, 1));
 	}
 
-	~Mat4(void)
+	static constexpr Mat4<TYPE>
+	scaling(TYPE const &x, TYPE const &y, TYPE const &z)
 	{
+		return (Mat4<TYPE>(x, 0, 0, 0,
+							0, y, 0, 0,
+							0, 0, z, 0,
+							0, 0, 0, 1));
+	}
+
+	/*
+	** Right-handed perspective projection. f is the cotangent of half the
+	** vertical field of view, precomputed by the caller since tan() cannot be
+	** evaluated at compile time.
+	*/
+	static constexpr Mat4<TYPE>
+	perspective(TYPE const &f, TYPE const &ratio, TYPE const &near, TYPE const &far)
+	{
+		return (Mat4<TYPE>(f / ratio, 0, 0, 0,
+							0, f, 0, 0,
+							0, 0, (far + near) / (near - far), -1,
+							0, 0, (2 * far * near) / (near - far), 0));
 	}
 
 	void
@@ -47,55 +209,22 @@ public:
 	void
 	reset(void)
 	{
-		int		i;
-
-		i = 0;
-		while (i < 16)
-		{
-			this->val[i] = 0;
-			++i;
-		}
+		*this = Mat4<TYPE>();
 	}
 
 	void
-	multiply(Mat4<TYPE> mat)
+	multiply(Mat4<TYPE> const &mat)
 	{
 		Mat4<TYPE>	res;
-		int			i;
-		int			j;
-		int			k;
 
-		i = 0;
-		while (i < 4)
-		{
-			j = 0;
-			while (j < 4)
-			{
-				res.val[j * 4 + i] = 0.0f;
-				k = 0;
-				while (k < 4)
-				{
-					res.val[j * 4 + i] += this->val[k * 4 + i] * mat.val[j * 4 + k];
-					k++;
-				}
-				j++;
-			}
-			i++;
-		}
+		mat4Multiply(res.val, this->val, mat.val);
 		*this = res;
 	}
 
 	void
 	setIdentity(void)
 	{
-		int			i;
-
-		i = -1;
-		while (i++, i < 16)
-			this->val[i] = 0.0f;
-		i = -1;
-		while (i++, i < 4)
-			this->val[i + i * 4] = 1.0f;
+		*this = identity();
 	}
 
 	void
@@ -108,39 +237,35 @@ public:
 		x		y		z		1
 		*/
 
-		this->setIdentity();
-		this->val[12] = x;
-		this->val[13] = y;
-		this->val[14] = z;
+		*this = translation(x, y, z);
 	}
 
 	void
 	translate(TYPE const &x, TYPE const &y, TYPE const &z)
 	{
-		Mat4<TYPE>		translate;
-
-		translate.setTranslation(x, y, z);
-		*this = *this * translate;
+		*this = *this * translation(x, y, z);
 	}
 
 	void
-	translate(Mat4<TYPE> translate)
+	translate(Mat4<TYPE> const &translate)
 	{
 		*this = *this * translate;
 	}
 
+	template<typename MATH = PreciseMath>
 	void
-	setRotation(float const &angle, TYPE &x,
-				TYPE &y, TYPE &z)
+	setRotation(float const &angle, TYPE x, TYPE y, TYPE z)
 	{
-		TYPE		s = sin(angle);
-		TYPE		c = cos(angle);
-		TYPE		oc = 1.0 - c;
-		TYPE const	h = sqrt(x * x + y * y + z * z);
-
-		x /= h;
-		y /= h;
-		z /= h;
+		TYPE		s;
+		TYPE		c;
+		TYPE		oc;
+		TYPE const	h = MATH::rsqrt(x * x + y * y + z * z);
+
+		MATH::sincos(TYPE(angle), s, c);
+		oc = 1 - c;
+		x *= h;
+		y *= h;
+		z *= h;
 		this->val[0] = oc * x * x + c;
 		this->val[1] = oc * x * y - z * s;
 		this->val[2] = oc * z * x + y * s;
@@ -159,17 +284,18 @@ public:
 		this->val[15] = 1.0;
 	}
 
+	template<typename MATH = PreciseMath>
 	void
-	rotate(float const &angle, TYPE &x, TYPE &y, TYPE &z)
+	rotate(float const &angle, TYPE const &x, TYPE const &y, TYPE const &z)
 	{
 		Mat4<TYPE>		rotation;
 
-		rotation.setRotation(angle / 180.0 * M_PI, x, y, z);
+		rotation.template setRotation<MATH>(angle / 180.0 * M_PI, x, y, z);
 		*this = *this * rotation;
 	}
 
 	void
-	rotate(Mat4<TYPE> rotation)
+	rotate(Mat4<TYPE> const &rotation)
 	{
 		*this = *this * rotation;
 	}
@@ -177,72 +303,27 @@ public:
 	void
 	setScale(TYPE const &x, TYPE const &y, TYPE const &z)
 	{
-		this->reset();
-
-		this->val[0] = x;
-		this->val[5] = y;
-		this->val[10] = z;
-		this->val[15] = 1;
+		*this = scaling(x, y, z);
 	}
 
 	void
 	scale(TYPE const &x, TYPE const &y, TYPE const &z)
 	{
-		Mat4<TYPE>	scale;
-
-		scale.setScale(x, y, z);
-		*this = *this * scale;
+		*this = *this * scaling(x, y, z);
 	}
 
 	void
-	scale(Mat4<TYPE> scale)
+	scale(Mat4<TYPE> const &scale)
 	{
 		*this = *this * scale;
 	}
 
-	Mat4<TYPE> &
-	operator=(Mat4<TYPE> const &rhs)
-	{
-		int		i;
-
-		i = 0;
-		if (this != & rhs)
-		{
-			while (i < 16)
-			{
-				this->val[i] = rhs.val[i];
-				++i;
-			}
-		}
-		return (*this);
-	}
-
 	Mat4<TYPE>
 	operator*(Mat4<TYPE> const & rhs) const
 	{
 		Mat4<TYPE>	res;
-		int			i;
-		int			j;
-		int			k;
-
 
-		i = 0;
-		while (i < 4)
-		{
-			j = 0;
-			while (j < 4)
-			{
-				res.val[j * 4 + i] = 0.0f;
-				k = 0;
-				while (k < 4)
-				{
-					res.val[j * 4 + i] += this->val[k * 4 + i] * rhs.val[j * 4 + k];
-					k++;
-				}
-				j++;
-			}
-			i++;
-		}
+		mat4Multiply(res.val, this->val, rhs.val);
 		return (res);
 	}
 
@@ -311,6 +392,12 @@ public:
 	{
 		return (val[i]);
 	}
+
+	constexpr TYPE const &
+	operator[](int const &i) const
+	{
+		return (val[i]);
+	}
 };
 
 template<typename TYPE>
@@ -0,0 +1,145 @@
+#ifndef MAT4BATCH_HPP
+# define MAT4BATCH_HPP
+
+# include <cstddef>
+# include "Simd.hpp"
+# include "Mat4.hpp"
+# include "Vec3.hpp"
+# include "Parallel.hpp"
+
+/*
+** Batched transforms: apply one matrix to many points, or compose one parent
+** matrix with many child matrices, in a single call.
+** Points are treated as (x, y, z, 1) and the matrix is assumed affine, no
+** perspective divide is done. Batches of at least BATCH_PARALLEL_MIN items
+** are split across hardware threads.
+*/
+
+# define BATCH_PARALLEL_MIN		(1 << 16)
+
+/* scalar kernels, any TYPE */
+
+template<typename TYPE>
+inline void
+transformPointsRange(TYPE const *m, TYPE const *x, TYPE const *y, TYPE const *z,
+					TYPE *ox, TYPE *oy, TYPE *oz, size_t i, size_t const &end)
+{
+	TYPE		px;
+	TYPE		py;
+	TYPE		pz;
+
+	while (i < end)
+	{
+		px = x[i];
+		py = y[i];
+		pz = z[i];
+		ox[i] = m[0] * px + m[4] * py + m[8] * pz + m[12];
+		oy[i] = m[1] * px + m[5] * py + m[9] * pz + m[13];
+		oz[i] = m[2] * px + m[6] * py + m[10] * pz + m[14];
+		++i;
+	}
+}
+
+template<typename TYPE>
+inline void
+transformPointsRange(TYPE const *m, Vec3<TYPE> const *in, Vec3<TYPE> *out,
+					size_t i, size_t const &end)
+{
+	TYPE		px;
+	TYPE		py;
+	TYPE		pz;
+
+	while (i < end)
+	{
+		px = in[i].x;
+		py = in[i].y;
+		pz = in[i].z;
+		out[i].x = m[0] * px + m[4] * py + m[8] * pz + m[12];
+		out[i].y = m[1] * px + m[5] * py + m[9] * pz + m[13];
+		out[i].z = m[2] * px + m[6] * py + m[10] * pz + m[14];
+		++i;
+	}
+}
+
+template<typename TYPE>
+inline void
+multiplyMatricesRange(Mat4<TYPE> const &parent, Mat4<TYPE> const *local,
+					Mat4<TYPE> *out, size_t i, size_t const &end)
+{
+	Mat4<TYPE>		res;
+
+	while (i < end)
+	{
+		mat4Multiply(res.val, parent.val, local[i].val);
+		out[i] = res;
+		++i;
+	}
+}
+
+/*
+** Single precision kernels, in Mat4Batch.cpp: AVX and FMA when the CPU has
+** them, SSE2 otherwise.
+*/
+void		transformPointsRange(float const *m, float const *x, float const *y,
+				float const *z, float *ox, float *oy, float *oz, size_t i, size_t const &end);
+void		multiplyMatricesRange(Mat4<float> const &parent, Mat4<float> const *local,
+				Mat4<float> *out, size_t i, size_t const &end);
+
+/* public entry points */
+
+/*
+** Structure-of-arrays points: out = m * (x, y, z, 1) for n points.
+** Output arrays may be the input arrays.
+*/
+template<typename TYPE>
+void
+transformPoints(Mat4<TYPE> const &m, TYPE const *x, TYPE const *y, TYPE const *z,
+				TYPE *ox, TYPE *oy, TYPE *oz, size_t const &n)
+{
+	TYPE const		*mv = m.val;
+
+	if (n < BATCH_PARALLEL_MIN)
+		return (transformPointsRange(mv, x, y, z, ox, oy, oz, 0, n));
+	parallelFor(n, BATCH_PARALLEL_MIN / 4, [=](size_t begin, size_t end)
+	{
+		transformPointsRange(mv, x, y, z, ox, oy, oz, begin, end);
+	});
+}
+
+/*
+** Array-of-structures points, same semantics. out may be in.
+*/
+template<typename TYPE>
+void
+transformPoints(Mat4<TYPE> const &m, Vec3<TYPE> const *in, Vec3<TYPE> *out, size_t const &n)
+{
+	TYPE const		*mv = m.val;
+
+	if (n < BATCH_PARALLEL_MIN)
+		return (transformPointsRange(mv, in, out, 0, n));
+	parallelFor(n, BATCH_PARALLEL_MIN / 4, [=](size_t begin, size_t end)
+	{
+		transformPointsRange(mv, in, out, begin, end);
+	});
+}
+
+/*
+** out[i] = parent * local[i] for n matrices, e.g. instance matrices sharing
+** a parent transform. out may be local.
+*/
+template<typename TYPE>
+void
+multiplyMatrices(Mat4<TYPE> const &parent, Mat4<TYPE> const *local,
+				Mat4<TYPE> *out, size_t const &n)
+{
+	Mat4<TYPE> const	*p = &parent;
+
+	if (n < BATCH_PARALLEL_MIN / 16)
+		return (multiplyMatricesRange(parent, local, out, 0, n));
+	parallelFor(n, BATCH_PARALLEL_MIN / 64, [=](size_t begin, size_t end)
+	{
+		multiplyMatricesRange(*p, local, out, begin, end);
+	});
+}
+
+#endif
@@ -1,22 +1,38 @@
 #ifndef MATSTACK_HPP
 # define MATSTACK_HPP
 
-# include <stack>
+# include <cstddef>
+# include <cstdlib>
+# include <iostream>
 # include "Mat4.hpp"
 # include "Vec3.hpp"
-
-template<typename T>
+# include "Affine.hpp"
+# include "Quat.hpp"
+
+# define MAT4STACK_DEPTH		(32)
+# define CACHE_LINE				(64)
+
+/*
+** Fixed-depth matrix stack with inline storage: push and pop never
+** allocate, and each entry sits on its own cache line. DEPTH counts the
+** identity matrix at the bottom. Overflow and underflow are only checked
+** in DEBUG builds.
+*/
+template<typename T, size_t DEPTH = MAT4STACK_DEPTH>
 class Mat4Stack
 {
 public:
-	std::stack<Mat4<T>>			stack;
-
-	Mat4Stack(void)
+	struct alignas(CACHE_LINE)	Entry
 	{
-		Mat4<T>		mat;
+		Mat4<T>					mat;
+	};
 
-		mat.setIdentity();
-		stack.push(mat);
+	Entry						stack[DEPTH];
+	size_t						depth;
+
+	Mat4Stack(void) : depth(0)
+	{
+		stack[0].mat.setIdentity();
 	}
 
 	~Mat4Stack(void)
@@ -25,50 +41,77 @@ public:
 
 	void			push(void)
 	{
-		Mat4<T>		mat;
-
-		mat = stack.top();
-		stack.push(mat);
+# ifdef DEBUG
+		if (depth + 1 >= DEPTH)
+		{
+			std::cerr << "Mat4Stack: overflow (depth " << DEPTH << ")" << std::endl;
+			abort();
+		}
+# endif
+		stack[depth + 1].mat = stack[depth].mat;
+		++depth;
 	}
 
 	void			pop(void)
 	{
-		stack.pop();
+# ifdef DEBUG
+		if (depth == 0)
+		{
+			std::cerr << "Mat4Stack: underflow" << std::endl;
+			abort();
+		}
+# endif
+		--depth;
 	}
 
 	Mat4<T> &		top(void)
 	{
-		return (stack.top());
+		return (stack[depth].mat);
+	}
+
+	size_t			size(void) const
+	{
+		return (depth + 1);
 	}
 
 	void			rotate(float const &angle, T x, T y, T z)
 	{
-		stack.top().rotate(angle, x, y, z);
+		top().rotate(angle, x, y, z);
 	}
 
 	void			rotate(float const &angle, Vec3<T> axis)
 	{
-		stack.top().rotate(angle, axis.x, axis.y, axis.z);
+		top().rotate(angle, axis.x, axis.y, axis.z);
+	}
+
+	void			rotate(Quat<T> const &rotation)
+	{
+		top() = top() * rotation.toAffine();
 	}
 
 	void			translate(T const &x, T const &y, T const &z)
 	{
-		stack.top().translate(x, y, z);
+		top().translate(x, y, z);
 	}
 
 	void			translate(Vec3<T> const &axis)
 	{
-		stack.top().translate(axis.x, axis.y, axis.z);
+		top().translate(axis.x, axis.y, axis.z);
 	}
 
 	void			scale(T const &x, T const &y, T const &z)
 	{
-		stack.top().scale(x, y, z);
+		top().scale(x, y, z);
 	}
 
 	void			scale(Vec3<T> const &axis)
 	{
-		stack.top().scale(axis.x, axis.y, axis.z);
+		top().scale(axis.x, axis.y, axis.z);
+	}
+
+	void			multiply(Affine<T> const &transform)
+	{
+		top() = top() * transform;
 	}
 
 private:
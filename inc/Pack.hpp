@@ -0,0 +1,124 @@
+#ifndef PACK_HPP
+# define PACK_HPP
+
+# include <string>
+# include <vector>
+# include <ctime>
+# include <stdint.h>
+# include <sys/stat.h>
+# include "MappedFile.hpp"
+
+# define PACK_E1				("Error opening pack")
+# define PACK_E2				("Bad pack header!")
+# define PACK_E3				("Failed to write pack")
+
+/* "PAK1" */
+# define PACK_MAGIC				(0x314B4150)
+# define PACK_VERSION			(1)
+/* entry data offsets are aligned to this, as TEX_ALIGN */
+# define PACK_ALIGN				(64)
+/* mounted by Core::init when present */
+# define PACK_DEFAULT			("./data.pak")
+/* entry flags */
+# define PACK_LZ4				(1)
+/* LZ4 expands a byte to at most 255, a larger rawSize is a corrupt entry */
+# define PACK_LZ4_RATIO			(255)
+
+/* modification time of a struct stat, with nanoseconds */
+# if defined(__APPLE__)
+#  define STAT_MTIME(st)		((st).st_mtimespec)
+# else
+#  define STAT_MTIME(st)		((st).st_mtim)
+# endif
+
+/*
+** Pack file, little-endian:
+**
+**	PackHeader
+**	PackEntry[count]			sorted by hash, then by name
+**	names						not NUL terminated
+**	entry data					PACK_ALIGN aligned
+*/
+struct PackHeader
+{
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			count;
+	uint32_t			namesSize;
+};
+
+struct PackEntry
+{
+	/* FNV-1a of the name */
+	uint64_t			hash;
+	uint64_t			offset;
+	/* stored, and once decompressed */
+	uint64_t			size;
+	uint64_t			rawSize;
+	/* from the start of the names */
+	uint32_t			name;
+	uint32_t			nameSize;
+	uint32_t			flags;
+	uint32_t			reserved;
+};
+
+/*
+** Archive of assets in one file, mapped once: a lookup is a binary search
+** of the table of contents, no open() or stat() per asset.
+**
+** Mounted packs are searched by MappedFile::open() before the disk, last
+** mounted first, so Bmp, TexFile, shaders and kernels all read packed
+** files by the name they had on disk ("./shaders/a.gls" and
+** "shaders/a.gls" are one name). Stored entries are views into the pack
+** mapping, compressed ones are decompressed into a buffer of their own.
+**
+** Packs are mounted and unmounted before any other thread opens files.
+*/
+class Pack
+{
+public:
+	Pack(void);
+	~Pack(void);
+
+	int						open(char const *filename);
+	PackEntry const *		find(std::string const &name) const;
+	unsigned char const *	data(PackEntry const *entry) const;
+
+	static int				mount(char const *filename);
+	static void				unmountAll(void);
+	/* the entry of name in the mounted packs, and its pack */
+	static PackEntry const	*resolve(char const *name, Pack const *&pack);
+	/*
+	** stat() as MappedFile::open() resolves name: a packed entry has its
+	** size once decompressed and the mtime of its pack. 1 if found.
+	*/
+	static int				stat(char const *name, struct stat &st);
+
+	/*
+	** Packs files under their names as given, through a temporary file
+	** renamed at the end. With compress, entries that LZ4 shrinks by at
+	** least an eighth are stored compressed.
+	*/
+	static int				build(char const *filename, std::vector<std::string> const &files,
+								bool const &compress);
+	static uint64_t			hash(std::string const &name);
+	/* strips "./" and doubled slashes */
+	static std::string		normalize(char const *name);
+
+private:
+	MappedFile				file;
+	PackHeader				header;
+	PackEntry const *		entries;
+	char const *			names;
+	struct timespec			mtime;
+
+	static std::vector<Pack *>	mounted;
+
+	int						validate(void);
+	int						error(char const *s);
+
+	Pack(Pack const &src);
+	Pack &					operator=(Pack const &rhs);
+};
+
+#endif
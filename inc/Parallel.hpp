@@ -0,0 +1,52 @@
+#ifndef PARALLEL_HPP
+# define PARALLEL_HPP
+
+# include <cstddef>
+# include <thread>
+# include <vector>
+
+/*
+** Split [0, count) into contiguous ranges and run func(begin, end) on each,
+** one range per hardware thread. The calling thread processes the first
+** range itself. Ranges are never smaller than grain, so small workloads
+** stay on the calling thread.
+*/
+template<typename FUNC>
+void
+parallelFor(size_t const &count, size_t const &grain, FUNC func)
+{
+	std::vector<std::thread>	threads;
+	size_t						workers;
+	size_t						chunk;
+	size_t						begin;
+	size_t						i;
+
+	workers = std::thread::hardware_concurrency();
+	if (workers == 0)
+		workers = 1;
+	if (grain > 0 && count / grain < workers)
+		workers = count / grain;
+	if (workers <= 1)
+	{
+		func(size_t(0), count);
+		return ;
+	}
+	chunk = (count + workers - 1) / workers;
+	i = 1;
+	while (i < workers)
+	{
+		begin = i * chunk;
+		if (begin < count)
+			threads.push_back(std::thread(func, begin, begin + chunk < count ? begin + chunk : count));
+		++i;
+	}
+	func(size_t(0), chunk);
+	i = 0;
+	while (i < threads.size())
+	{
+		threads[i].join();
+		++i;
+	}
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef PROGRAMCACHE_HPP
+# define PROGRAMCACHE_HPP
+
+# include <string>
+# include <vector>
+# include <stdint.h>
+# include "Utils.hpp"
+
+# define PROGRAM_E1				("Bad program cache header!")
+# define PROGRAM_E2				("Failed to write program cache")
+
+/* "PRG1" */
+# define PROGRAM_MAGIC			(0x31475250)
+/* bumped when what is bound before linking changes */
+# define PROGRAM_VERSION		(1)
+# define PROGRAM_CACHE_DIR		("./cache/")
+# define PROGRAM_EXTENSION		(".prog")
+
+/*
+** Program binary, as glGetProgramBinary() returned it:
+**
+**	ProgramHeader
+**	binary						size bytes
+*/
+struct ProgramHeader
+{
+	uint32_t			magic;
+	uint32_t			version;
+	uint64_t			key;
+	uint32_t			format;
+	uint32_t			size;
+};
+
+/*
+** Linked programs kept on disk, PROGRAM_CACHE_DIR/<name>.prog, so a launch
+** does not compile and link them again.
+**
+** A program is keyed by the 64-bit FNV-1a of its sources chained to the
+** driver (vendor, renderer, GL and GLSL versions): a binary is only loaded
+** under the key it was stored with, and only if the driver still accepts
+** it, load() returns 0 otherwise and the program is compiled as before,
+** then stored over the stale one.
+**
+** Disabled, every load() failing, when the driver has no binary format.
+** Needs the GL context current.
+*/
+class ProgramCache
+{
+public:
+	ProgramCache(void);
+	~ProgramCache(void);
+
+	/* 1 if binaries are supported */
+	int						init(void);
+	/* key of a program from its source files, 0 if one cannot be read */
+	uint64_t				key(char const * const *files, size_t const &count) const;
+
+	GLuint					load(char const *name, uint64_t const &key) const;
+	/*
+	** The program must have been linked with
+	** GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+	*/
+	int						store(char const *name, uint64_t const &key,
+								GLuint const &program) const;
+
+private:
+	std::vector<GLint>		formats;
+	uint64_t				driver;
+
+	std::string				path(char const *name) const;
+
+	ProgramCache(ProgramCache const &src);
+	ProgramCache &			operator=(ProgramCache const &rhs);
+};
+
+#endif
@@ -0,0 +1,246 @@
+#ifndef QUAT_HPP
+# define QUAT_HPP
+
+# include <cmath>
+# include <iostream>
+# include "Simd.hpp"
+# include "Vec3.hpp"
+# include "Mat4.hpp"
+# include "Affine.hpp"
+
+/*
+** q = a * b (Hamilton product), quaternions stored as x, y, z, w.
+*/
+template<typename TYPE>
+inline void
+quatMultiply(TYPE *res, TYPE const *a, TYPE const *b)
+{
+	TYPE const	x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	TYPE const	y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+	TYPE const	z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+	TYPE const	w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+
+	res[0] = x;
+	res[1] = y;
+	res[2] = z;
+	res[3] = w;
+}
+
+/*
+** Each component of a scales a permutation of b with a sign pattern:
+**	aw * ( bx,  by,  bz,  bw)
+**	ax * ( bw, -bz,  by, -bx)
+**	ay * ( bz,  bw, -bx, -by)
+**	az * (-by,  bx,  bw, -bz)
+*/
+template<>
+inline void
+quatMultiply<float>(float *res, float const *a, float const *b)
+{
+# if defined(SIMD_SSE2)
+	__m128 const	va = _mm_loadu_ps(a);
+	__m128 const	vb = _mm_loadu_ps(b);
+	__m128 const	s1 = _mm_set_ps(-0.0f, 0.0f, -0.0f, 0.0f);
+	__m128 const	s2 = _mm_set_ps(-0.0f, -0.0f, 0.0f, 0.0f);
+	__m128 const	s3 = _mm_set_ps(-0.0f, 0.0f, 0.0f, -0.0f);
+	__m128			r;
+
+	r = _mm_mul_ps(_mm_shuffle_ps(va, va, 0xFF), vb);
+	r = _mm_add_ps(r, _mm_xor_ps(s1, _mm_mul_ps(_mm_shuffle_ps(va, va, 0x00),
+									_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(0, 1, 2, 3)))));
+	r = _mm_add_ps(r, _mm_xor_ps(s2, _mm_mul_ps(_mm_shuffle_ps(va, va, 0x55),
+									_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(1, 0, 3, 2)))));
+	r = _mm_add_ps(r, _mm_xor_ps(s3, _mm_mul_ps(_mm_shuffle_ps(va, va, 0xAA),
+									_mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 3, 0, 1)))));
+	_mm_storeu_ps(res, r);
+# else
+	float const	x = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	float const	y = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+	float const	z = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+	float const	w = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+
+	res[0] = x;
+	res[1] = y;
+	res[2] = z;
+	res[3] = w;
+# endif
+}
+
+/*
+** Rotation quaternion. Trigonometry is only needed to build one from an
+** angle; composing, interpolating and converting to a matrix are purely
+** arithmetic. Rotations follow the same convention as Mat4::setRotation,
+** so toMat4(fromAxisAngle(a, x, y, z)) == Mat4::setRotation(a, x, y, z).
+*/
+template<typename TYPE>
+class Quat
+{
+public:
+	alignas(SIMD_ALIGN) TYPE	val[4];
+
+	constexpr Quat(void) : val{0, 0, 0, 1}
+	{
+	}
+
+	constexpr Quat(TYPE const &x, TYPE const &y, TYPE const &z, TYPE const &w)
+		: val{x, y, z, w}
+	{
+	}
+
+	static constexpr Quat<TYPE>
+	identity(void)
+	{
+		return (Quat<TYPE>());
+	}
+
+	/* angle in radians, the axis does not need to be normalized */
+	template<typename MATH = PreciseMath>
+	static Quat<TYPE>
+	fromAxisAngle(TYPE const &angle, TYPE const &x, TYPE const &y, TYPE const &z)
+	{
+		TYPE const	h = MATH::rsqrt(x * x + y * y + z * z);
+		TYPE		s;
+		TYPE		c;
+
+		MATH::sincos(TYPE(angle * TYPE(0.5)), s, c);
+		s = -s * h;
+		return (Quat<TYPE>(x * s, y * s, z * s, c));
+	}
+
+	template<typename MATH = PreciseMath>
+	static Quat<TYPE>
+	fromAxisAngle(TYPE const &angle, Vec3<TYPE> const &axis)
+	{
+		return (fromAxisAngle<MATH>(angle, axis.x, axis.y, axis.z));
+	}
+
+	constexpr TYPE
+	dot(Quat<TYPE> const &q) const
+	{
+		return (val[0] * q.val[0] + val[1] * q.val[1] + val[2] * q.val[2] + val[3] * q.val[3]);
+	}
+
+	constexpr Quat<TYPE>
+	conjugate(void) const
+	{
+		return (Quat<TYPE>(-val[0], -val[1], -val[2], val[3]));
+	}
+
+	void
+	normalize(void)
+	{
+		TYPE const	h = PreciseMath::rsqrt(dot(*this));
+
+		val[0] *= h;
+		val[1] *= h;
+		val[2] *= h;
+		val[3] *= h;
+	}
+
+	/*
+	** Normalized linear interpolation along the shortest arc. Not constant
+	** speed, but cheap and good enough for small steps between keys.
+	*/
+	static Quat<TYPE>
+	nlerp(Quat<TYPE> const &a, Quat<TYPE> const &b, TYPE const &t)
+	{
+		TYPE const	tb = a.dot(b) < 0 ? -t : t;
+		TYPE const	ta = 1 - t;
+		Quat<TYPE>	r(a.val[0] * ta + b.val[0] * tb, a.val[1] * ta + b.val[1] * tb,
+						a.val[2] * ta + b.val[2] * tb, a.val[3] * ta + b.val[3] * tb);
+
+		r.normalize();
+		return (r);
+	}
+
+	/*
+	** Spherical linear interpolation along the shortest arc, constant
+	** angular speed. Falls back to nlerp when a and b are nearly parallel.
+	*/
+	static Quat<TYPE>
+	slerp(Quat<TYPE> const &a, Quat<TYPE> const &b, TYPE const &t)
+	{
+		TYPE		d = a.dot(b);
+		TYPE		sign;
+		TYPE		theta;
+		TYPE		s;
+		TYPE		ta;
+		TYPE		tb;
+
+		sign = 1;
+		if (d < 0)
+		{
+			d = -d;
+			sign = -1;
+		}
+		if (d > TYPE(0.9995))
+			return (nlerp(a, b, t));
+		theta = acos(d);
+		s = 1 / sin(theta);
+		ta = sin((1 - t) * theta) * s;
+		tb = sin(t * theta) * s * sign;
+		return (Quat<TYPE>(a.val[0] * ta + b.val[0] * tb, a.val[1] * ta + b.val[1] * tb,
+							a.val[2] * ta + b.val[2] * tb, a.val[3] * ta + b.val[3] * tb));
+	}
+
+	/* q must be normalized */
+	Vec3<TYPE>
+	rotate(Vec3<TYPE> const &v) const
+	{
+		Vec3<TYPE> const	u(val[0], val[1], val[2]);
+		Vec3<TYPE> const	t = u.crossProduct(v) * TYPE(2);
+
+		return (v + t * val[3] + u.crossProduct(t));
+	}
+
+	/* q must be normalized */
+	constexpr Affine<TYPE>
+	toAffine(void) const
+	{
+		return (Affine<TYPE>(
+			1 - 2 * (val[1] * val[1] + val[2] * val[2]),
+			2 * (val[0] * val[1] + val[3] * val[2]),
+			2 * (val[0] * val[2] - val[3] * val[1]),
+			2 * (val[0] * val[1] - val[3] * val[2]),
+			1 - 2 * (val[0] * val[0] + val[2] * val[2]),
+			2 * (val[1] * val[2] + val[3] * val[0]),
+			2 * (val[0] * val[2] + val[3] * val[1]),
+			2 * (val[1] * val[2] - val[3] * val[0]),
+			1 - 2 * (val[0] * val[0] + val[1] * val[1]),
+			0, 0, 0));
+	}
+
+	/* q must be normalized */
+	constexpr Mat4<TYPE>
+	toMat4(void) const
+	{
+		return (toAffine().toMat4());
+	}
+
+	Quat<TYPE>
+	operator*(Quat<TYPE> const &rhs) const
+	{
+		Quat<TYPE>	res;
+
+		quatMultiply(res.val, this->val, rhs.val);
+		return (res);
+	}
+
+	Quat<TYPE> &
+	operator*=(Quat<TYPE> const &rhs)
+	{
+		quatMultiply(this->val, this->val, rhs.val);
+		return (*this);
+	}
+};
+
+template<typename TYPE>
+std::ostream &
+operator<<(std::ostream &o, Quat<TYPE> const &q)
+{
+	o	<< "x: " << q.val[0] << ", y: " << q.val[1]
+		<< ", z: " << q.val[2] << ", w: " << q.val[3];
+	return (o);
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef SHADERPERMUTATIONS_HPP
+# define SHADERPERMUTATIONS_HPP
+
+# include <deque>
+# include <string>
+# include <vector>
+# include <unordered_map>
+# include <stdint.h>
+# include "Utils.hpp"
+# include "ProgramCache.hpp"
+
+/* GL_KHR_parallel_shader_compile, same value as the ARB one */
+# ifndef GL_COMPLETION_STATUS_KHR
+#  define GL_COMPLETION_STATUS_KHR		(0x91B1)
+# endif
+
+# define PERMUTATION_E1					("Too many shader features")
+# define PERMUTATION_E2					("Shader variant with an unknown feature")
+
+/* 31, so the top bit and PERMUTATION_NO_FEATURE are never a valid mask */
+# define PERMUTATION_MAX_FEATURES		(31)
+/* returned by feature() once full, request() turns it down */
+# define PERMUTATION_NO_FEATURE			(UINT32_MAX)
+/* variants taken from the queue per update(), loaded from cache or not */
+# define PERMUTATION_STARTS_PER_FRAME	(8)
+/* variants compiled per update() without the extension, stalls a frame each */
+# define PERMUTATION_COMPILES_PER_FRAME	(1)
+/* variants the driver compiles at once with it */
+# define PERMUTATION_IN_FLIGHT			(16)
+
+/*
+** Variants of one vertex/fragment pair, one per set of features: a
+** variant is the sources with "#define <feature> 1" for each of its bits
+** inserted after #version, linked to a program.
+**
+** request() queues a variant, update() (once a frame) starts queued ones:
+**
+**	- from their binary in the ProgramCache;
+**	- with GL_KHR_parallel_shader_compile, up to PERMUTATION_IN_FLIGHT
+**	  at a time on the driver threads: the frame only polls their status;
+**	- otherwise PERMUTATION_COMPILES_PER_FRAME a frame.
+**
+** At most PERMUTATION_STARTS_PER_FRAME are started in one update().
+**
+** Linked variants are stored in the cache. get() does not wait, a material
+** draws with a fallback until its variant is there; requesting the
+** variants a level needs while it loads keeps that from happening.
+** Needs the GL context current; programs are left to the context.
+*/
+class ShaderPermutations
+{
+public:
+	ShaderPermutations(ProgramCache &cache);
+	~ShaderPermutations(void);
+
+	int						init(char const *name, char const *vertexFile,
+								char const *fragmentFile);
+	/* the bit of a define, PERMUTATION_NO_FEATURE past PERMUTATION_MAX_FEATURES */
+	uint32_t				feature(char const *define);
+
+	/* masks with a bit no feature() returned are reported and ignored */
+	void					request(uint32_t const &mask);
+	/* 0 until the variant is linked, or if it failed or is unknown */
+	GLuint					get(uint32_t const &mask);
+	/* compiles the variant now if it is not there yet */
+	GLuint					wait(uint32_t const &mask);
+	void					update(void);
+	/* variants queued or compiling */
+	size_t					pending(void) const;
+	bool					parallel(void) const;
+
+private:
+	enum
+	{
+		VARIANT_QUEUED,
+		VARIANT_COMPILING,
+		VARIANT_LINKING,
+		VARIANT_READY,
+		VARIANT_FAILED
+	};
+
+	struct Variant
+	{
+		int					state;
+		GLuint				vertex;
+		GLuint				fragment;
+		GLuint				program;
+		uint64_t			key;
+	};
+
+	ProgramCache &						cache;
+	std::string							name;
+	/* up to the end of the #version line, and the rest */
+	std::string							head[2];
+	std::string							body[2];
+	/* "#line" making errors point at the file */
+	std::string							line[2];
+	uint64_t							baseKey;
+	std::vector<std::string>			features;
+	std::unordered_map<uint32_t, Variant>	variants;
+	std::deque<uint32_t>				queue;
+	std::vector<uint32_t>				compiling;
+	bool								threads;
+
+	bool					known(uint32_t const &mask) const;
+	std::string				defines(uint32_t const &mask) const;
+	void					start(uint32_t const &mask, Variant &v);
+	GLuint					compile(GLenum const &type, int const &stage,
+								std::string const &defs);
+	void					advance(uint32_t const &mask, Variant &v, bool const &block);
+	void					fail(Variant &v);
+	bool					done(GLuint const &object, bool const &program) const;
+
+	ShaderPermutations(ShaderPermutations const &src);
+	ShaderPermutations &	operator=(ShaderPermutations const &rhs);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SIMD_HPP
+# define SIMD_HPP
+
+/*
+** Instruction set selection, resolved at compile time from the compiler's
+** target flags (see the -march line in the Makefile).
+** SSE2 is the baseline on every x86_64 target; AVX and FMA are only used
+** when the compiler is allowed to emit them. Other architectures fall back
+** to the scalar code paths.
+*/
+
+# if defined(__SSE2__) || defined(_M_X64)
+#  define SIMD_SSE2
+#  include <emmintrin.h>
+# endif
+
+# if defined(SIMD_SSE2) && defined(__SSSE3__)
+#  define SIMD_SSSE3
+#  include <tmmintrin.h>
+# endif
+
+# if defined(SIMD_SSE2) && defined(__AVX__)
+#  define SIMD_AVX
+#  include <immintrin.h>
+# endif
+
+# if defined(SIMD_AVX) && defined(__AVX2__)
+#  define SIMD_AVX2
+# endif
+
+# if defined(SIMD_AVX) && defined(__FMA__)
+#  define SIMD_FMA
+# endif
+
+# define SIMD_ALIGN				(16)
+
+/*
+** Run time dispatch: kernels in source files are also built for wider
+** instruction sets with SIMD_TARGET and picked with simdLevel(), so a
+** build without -march still runs them on CPUs that have them. Inline
+** header code keeps the compile time selection above.
+*/
+# if defined(SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#  define SIMD_DISPATCH
+#  include <immintrin.h>
+#  define SIMD_TARGET(isa)		__attribute__((target(isa)))
+
+#  define SIMD_LEVEL_SSE2		(0)
+#  define SIMD_LEVEL_SSSE3		(1)
+/* AVX2 and FMA, every CPU with the first has the second */
+#  define SIMD_LEVEL_AVX2		(2)
+
+inline int
+simdLevel(void)
+{
+	static int const	level = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")
+		? SIMD_LEVEL_AVX2 : (__builtin_cpu_supports("ssse3") ? SIMD_LEVEL_SSSE3 : SIMD_LEVEL_SSE2);
+
+	return (level);
+}
+# endif
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef SWIZZLE_HPP
+# define SWIZZLE_HPP
+
+# include <cstddef>
+
+/*
+** Pixel channel reordering for 8-bit images. order[c] is the source byte
+** of destination channel c, e.g. { 2, 1, 0 } turns BGR into RGB.
+** Vectorized with SSSE3 (pshufb) and AVX2 when the CPU has them (see
+** simdLevel), scalar otherwise. dst and src must not overlap.
+*/
+
+/* 3 bytes -> 3 bytes per pixel */
+void			swizzle24to24(unsigned char *dst, unsigned char const *src,
+							size_t count, unsigned char const *order);
+/* 3 bytes -> 4 bytes per pixel, the fourth channel set to alpha */
+void			swizzle24to32(unsigned char *dst, unsigned char const *src,
+							size_t count, unsigned char const *order,
+							unsigned char alpha);
+/* 4 bytes -> 4 bytes per pixel */
+void			swizzle32to32(unsigned char *dst, unsigned char const *src,
+							size_t count, unsigned char const *order);
+
+#endif
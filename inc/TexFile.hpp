@@ -0,0 +1,115 @@
+#ifndef TEXFILE_HPP
+# define TEXFILE_HPP
+
+# include <stdint.h>
+# include <cstddef>
+# include "Bmp.hpp"
+# include "MappedFile.hpp"
+
+# define TEX_E1					("Error opening texture cache")
+# define TEX_E2					("Bad texture cache header!")
+# define TEX_E3					("Failed to decompress texture cache")
+# define TEX_E4					("Failed to write texture cache")
+
+/* "TEX1" */
+# define TEX_MAGIC				(0x31584554)
+# define TEX_VERSION			(2)
+/* level data offsets are aligned to this */
+# define TEX_ALIGN				(64)
+# define TEX_MAX_LEVELS			(16)
+# define TEX_EXTENSION			(".tex")
+
+/* formats */
+# define TEX_RGBA8				(0)
+# define TEX_BC1				(1)
+# define TEX_BC3				(2)
+
+/* flags */
+# define TEX_LZ4				(1 << 0)
+/* cook only: block compress, BC1 if the image is opaque, BC3 otherwise */
+# define TEX_BC					(1 << 1)
+
+/*
+** Cooked texture, little-endian, laid out to be mapped and handed to GL
+** as is:
+**
+**	TexHeader
+**	TexLevel[levels]			largest first
+**	level data					each at a TEX_ALIGN offset, rows bottom
+**								first, RGBA or BC1/BC3 blocks, LZ4
+**								blocks on top if TEX_LZ4
+*/
+struct TexHeader
+{
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			format;
+	uint32_t			flags;
+	uint32_t			width;
+	uint32_t			height;
+	uint32_t			levels;
+	uint32_t			reserved;
+};
+
+struct TexLevel
+{
+	uint32_t			width;
+	uint32_t			height;
+	/* from the start of the file */
+	uint64_t			offset;
+	/* stored, compressed if TEX_LZ4 */
+	uint64_t			size;
+	/* once decompressed */
+	uint64_t			rawSize;
+};
+
+/*
+** Loads a cooked texture. Uncompressed levels are used straight from the
+** read-only mapping, or from the bytes load() was given; compressed ones
+** are decompressed once at load() into a single buffer. The levels stay
+** valid until unload().
+*/
+class TexFile
+{
+public:
+	TexHeader			header;
+	TexLevel			levels[TEX_MAX_LEVELS];
+	/* level data, in file or in buffer */
+	unsigned char const	*data[TEX_MAX_LEVELS];
+
+	MappedFile			file;
+	unsigned char		*buffer;
+
+	TexFile(void);
+	~TexFile(void);
+
+	int					load(char const *filename);
+	/* from a new[] buffer holding the whole file, which it now owns */
+	int					load(unsigned char *bytes, size_t const &size);
+	void				unload(void);
+
+	/*
+	** Writes bmp and its mip chain (2x2 box filter down to 1x1) to
+	** filename, through a temporary file renamed at the end so a reader
+	** never sees a partial cache.
+	*/
+	static int			cook(Bmp const &bmp, char const *filename, uint32_t const &flags);
+
+	static size_t		levelSize(uint32_t const &format, uint32_t const &width,
+								uint32_t const &height);
+	static uint32_t		levelCount(uint32_t const &width, uint32_t const &height);
+	/* dst is max(1, width / 2) x max(1, height / 2) */
+	static void			downsample(unsigned char const *src, uint32_t const &width,
+									uint32_t const &height, unsigned char *dst);
+
+private:
+	/* load() once file holds the data */
+	int					parse(void);
+	int					validate(void);
+	static int			error(char const *s);
+
+	TexFile(TexFile const &src);
+	TexFile &			operator=(TexFile const &rhs);
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef TEXTURECACHE_HPP
+# define TEXTURECACHE_HPP
+
+# include <deque>
+# include <list>
+# include <mutex>
+# include <condition_variable>
+# include <string>
+# include <vector>
+# include <unordered_map>
+# include <stdint.h>
+# include <sys/stat.h>
+# include "Utils.hpp"
+# include "ThreadPool.hpp"
+# include "TextureLoader.hpp"
+# include "TextureStreamer.hpp"
+
+/* default size, in bytes, of the textures kept loaded */
+# define TEXTURE_CACHE_BUDGET	(256 << 20)
+
+/*
+** Shared textures. acquire() returns the texture already loaded for a
+** path and adds a reference; release() removes one. A path is looked up
+** by its size and modification time only, so acquire() never reads the
+** file.
+**
+** Files are also matched by content (64-bit FNV-1a of the file, or of its
+** cooked .tex when the bmp is not shipped), hashed on the pool while the
+** texture loads. update() applies the result: a file with the same
+** content as a texture already there is a duplicate, its path is moved to
+** the shared texture for the next acquire(), and the duplicate is deleted
+** once released.
+**
+** Textures nobody references stay loaded, so acquiring them again is
+** free, until the cache holds more than budget bytes: they are then
+** deleted least recently released first. Referenced textures and those
+** still loading or hashing are never evicted, so what is in use may
+** exceed budget.
+**
+** GL thread only. Sizes are reported by the loader once a texture is
+** handed to the streamer.
+*/
+class TextureCache
+{
+public:
+	size_t						budget;
+
+	TextureCache(ThreadPool &pool, TextureLoader &loader, TextureStreamer &streamer);
+	~TextureCache(void);
+
+	GLuint						acquire(char const *filename);
+	void						release(GLuint const &texture);
+	/* shares the files hashed since the last call, once a frame */
+	void						update(void);
+	/* evicts unreferenced textures until the cache fits in budget */
+	void						trim(void);
+	/* bytes taken by the textures loaded so far */
+	size_t						size(void) const;
+	size_t						count(void) const;
+
+private:
+	struct Entry
+	{
+		GLuint					texture;
+		uint64_t				hash;
+		size_t					refs;
+		size_t					bytes;
+		/* handed to the streamer, or failed: safe to delete */
+		bool					loaded;
+		/* content hash not known yet */
+		bool					hashing;
+		/* same content as another entry, deleted once released */
+		bool					duplicate;
+		/* the file hashed */
+		std::string				file;
+		std::vector<std::string>	paths;
+		/* position in idle, when refs is 0 */
+		std::list<Entry *>::iterator	lru;
+	};
+
+	struct Source
+	{
+		Entry *					entry;
+		off_t					size;
+		time_t					mtime;
+	};
+
+	ThreadPool &				pool;
+	TextureLoader &				loader;
+	TextureStreamer &			streamer;
+	std::unordered_map<std::string, Source>		sources;
+	std::unordered_map<uint64_t, Entry *>		hashes;
+	std::unordered_map<GLuint, Entry *>			entries;
+	/* unreferenced entries, least recently released first */
+	std::list<Entry *>			idle;
+	size_t						bytes;
+	/* hashes done on the pool, drained by update() */
+	std::mutex					mutex;
+	std::condition_variable		cond;
+	/* entry, and whether its file could be read */
+	std::deque<std::pair<Entry *, bool>>	hashed;
+	size_t						hashing;
+
+	void						hash(Entry *entry);
+	void						share(Entry *entry);
+	void						uploaded(GLuint const &texture, size_t const &size);
+	void						evict(Entry *entry);
+	static int					hashFile(std::string const &filename, uint64_t &hash);
+
+	TextureCache(TextureCache const &src);
+	TextureCache &				operator=(TextureCache const &rhs);
+};
+
+#endif
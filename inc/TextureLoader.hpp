@@ -0,0 +1,98 @@
+#ifndef TEXTURELOADER_HPP
+# define TEXTURELOADER_HPP
+
+# include <atomic>
+# include <deque>
+# include <mutex>
+# include <condition_variable>
+# include <string>
+# include <functional>
+# include "Utils.hpp"
+# include "Bmp.hpp"
+# include "ThreadPool.hpp"
+# include "AssetIO.hpp"
+# include "TextureStreamer.hpp"
+# include "TexFile.hpp"
+
+/* rows decoded per task, a 4096x4096 image is split in 16 tasks */
+# define TEXTURE_BAND_ROWS		(256)
+/* TexFile::cook flags for the caches written next to the bmps, TEX_BC
+** is left out when the driver has no S3TC */
+# define TEXTURE_CACHE_FLAGS	(TEX_BC)
+/* AssetIO priority of the file reads, below the virtual texture pages */
+# define TEXTURE_READ_PRIORITY	(-1)
+
+/*
+** Asynchronous texture loading. request() reserves a texture name on the
+** GL thread and queues the load on the pool. Files on disk are read whole
+** through AssetIO, so no worker blocks on the disk; packed ones are
+** already in memory. Large images are then decoded as bands of
+** TEXTURE_BAND_ROWS rows by several workers at once. Decoded images land
+** in a completion queue that the GL thread drains with upload(), which
+** hands them to the streamer.
+**
+** Each bmp is cooked once into filename.bmp.tex (see TexFile), later
+** requests map that file instead and skip decoding and mipmapping. A
+** cooked file in a format the streamer cannot upload is cooked again.
+**
+** Until it is streamed a texture has no storage and samples as black.
+*/
+class TextureLoader
+{
+public:
+	/* texture, size it will take once streamed (0 if it failed to load) */
+	typedef std::function<void(GLuint const &, size_t const &)>	UploadCallback;
+
+	/* called by upload() for each image handed to the streamer, if set */
+	UploadCallback				uploaded;
+
+	TextureLoader(ThreadPool &pool, AssetIO &io, TextureStreamer &streamer);
+	~TextureLoader(void);
+
+	GLuint						request(char const *filename);
+	/* queues at most maxCount decoded images for streaming */
+	size_t						upload(size_t const &maxCount);
+	/* blocks until every request is decoded and uploaded */
+	void						finish(void);
+	size_t						pending(void);
+
+private:
+	struct Job
+	{
+		GLuint					texture;
+		std::string				filename;
+		Bmp *					bmp;
+		TexFile *				tex;
+		/* reading the cooked texture rather than the bmp */
+		bool					cached;
+		/* the read in flight, buffer is 0 for a file opened by name */
+		int						fd;
+		unsigned char *			buffer;
+		size_t					size;
+		ssize_t					result;
+		std::atomic<uint32_t>	bands;
+		std::atomic<int>		failed;
+	};
+
+	ThreadPool &				pool;
+	AssetIO &					io;
+	TextureStreamer &			streamer;
+	std::mutex					mutex;
+	std::condition_variable		cond;
+	std::deque<Job *>			done;
+	size_t						inFlight;
+
+	void						decode(Job *job);
+	void						read(Job *job);
+	void						readDone(Job *job);
+	void						parse(Job *job);
+	void						decodeBand(Job *job, uint32_t const &first, uint32_t const &count);
+	void						cook(Job *job);
+	void						complete(Job *job);
+	void						wait(void);
+
+	TextureLoader(TextureLoader const &src);
+	TextureLoader &				operator=(TextureLoader const &rhs);
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef TEXTURESTREAMER_HPP
+# define TEXTURESTREAMER_HPP
+
+# include <deque>
+# include "Utils.hpp"
+# include "Bmp.hpp"
+# include "TexFile.hpp"
+
+/* staging buffers in the ring, and the size of each */
+# define TEXTURE_PBO_COUNT			(3)
+# define TEXTURE_PBO_SIZE			(4 << 20)
+/* default number of bytes staged per frame */
+# define TEXTURE_UPLOAD_BUDGET		(8 << 20)
+/* levels this small skip the ring, mostly the tail of a mip chain */
+# define TEXTURE_DIRECT_SIZE		(64 << 10)
+
+/* EXT_texture_compression_s3tc, not core: checked by init() */
+# ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#  define GL_COMPRESSED_RGB_S3TC_DXT1_EXT	(0x83F0)
+# endif
+# ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#  define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT	(0x83F3)
+# endif
+
+/*
+** Streams decoded images to their textures through a ring of pixel
+** buffer objects, so the copy to the GPU never blocks the frame:
+**
+**	- a slot is only reused once the fence placed after its last
+**	  glTexSubImage2D is signaled, otherwise update() stops for this frame;
+**	- the slot is mapped unsynchronized, filled with as many whole rows as
+**	  fit in the slot and in what is left of the frame budget, then
+**	  unmapped and uploaded with glTexSubImage2D;
+**	- a cooked texture streams all its levels, largest first, RGBA or
+**	  BC1/BC3 blocks; a Bmp only has one and mipmaps are generated once
+**	  its last row is uploaded.
+**
+** Large images are thus spread over several frames. init() must be called
+** with a current GL context. BC1/BC3 textures need the S3TC extension,
+** see supports().
+*/
+class TextureStreamer
+{
+public:
+	size_t					budget;
+
+	TextureStreamer(void);
+	~TextureStreamer(void);
+
+	int						init(void);
+	/*
+	** Whether textures of a TexFile format can be streamed, known once
+	** init() ran and safe to call from any thread afterwards.
+	*/
+	bool					supports(uint32_t const &format) const;
+	/*
+	** take ownership of bmp or tex, which must have been allocated with new;
+	** a tex the driver cannot use is reported and dropped
+	*/
+	void					push(GLuint const &texture, Bmp *bmp);
+	void					push(GLuint const &texture, TexFile *tex);
+	/* drops what is left to stream to texture, before it is deleted */
+	void					cancel(GLuint const &texture);
+	/* stages at most budget bytes, returns how many were */
+	size_t					update(void);
+	/* uploads everything queued, waiting for the GPU when needed */
+	void					flush(void);
+	size_t					pending(void) const;
+
+private:
+	struct Item
+	{
+		GLuint				texture;
+		Bmp *				bmp;
+		TexFile *			tex;
+		uint32_t			levels;
+		uint32_t			level;
+		uint32_t			row;
+	};
+
+	struct Level
+	{
+		uint32_t			width;
+		uint32_t			height;
+		unsigned char const	*pixels;
+		/* compressed GL format, 0 for RGBA */
+		GLenum				format;
+		uint32_t			lineRows;
+		uint32_t			lines;
+		size_t				lineSize;
+	};
+
+	struct Slot
+	{
+		GLuint				pbo;
+		GLsync				fence;
+	};
+
+	Slot					slots[TEXTURE_PBO_COUNT];
+	size_t					current;
+	bool					s3tc;
+	std::deque<Item>		items;
+
+	size_t					stream(size_t const &bytes, bool const &wait);
+	static void				levelInfo(Item const &item, Level &level);
+	void					allocate(Item const &item, Level const &level, bool const &direct);
+	void					upload(Item const &item, Level const &level,
+									uint32_t const &first, uint32_t const &count);
+	int						acquire(Slot &slot, bool const &wait);
+
+	TextureStreamer(TextureStreamer const &src);
+	TextureStreamer &		operator=(TextureStreamer const &rhs);
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef THREADPOOL_HPP
+# define THREADPOOL_HPP
+
+# include <cstddef>
+# include <deque>
+# include <functional>
+# include <mutex>
+# include <condition_variable>
+# include <thread>
+# include <vector>
+
+/*
+** Fixed set of worker threads consuming a FIFO of tasks. Tasks must not
+** wait on other tasks; a task can submit more work. The destructor runs
+** the tasks still queued, then joins the workers.
+*/
+class ThreadPool
+{
+public:
+	ThreadPool(void);
+	ThreadPool(size_t const &workers);
+	~ThreadPool(void);
+
+	void								submit(std::function<void(void)> const &task);
+	size_t								size(void) const;
+
+private:
+	std::vector<std::thread>			threads;
+	std::deque<std::function<void(void)>>	tasks;
+	std::mutex							mutex;
+	std::condition_variable				cond;
+	bool								stopping;
+
+	void								start(size_t workers);
+	void								work(void);
+
+	ThreadPool(ThreadPool const &src);
+	ThreadPool &						operator=(ThreadPool const &rhs);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef TRANSFORMTREE_HPP
+# define TRANSFORMTREE_HPP
+
+# include <cstddef>
+# include <vector>
+# include "Mat4.hpp"
+
+# define TRANSFORM_ROOT			(-1)
+
+/*
+** Flattened scene transform hierarchy. Nodes live in parallel arrays
+** (parent index, local matrix, world matrix, dirty flag, first child, next
+** sibling) sorted so that a parent always comes before its children.
+** setLocal() records the node as the root of a dirty subtree; update()
+** only walks those subtrees, so its cost is the number of nodes whose
+** world matrix changes, not the size of the tree.
+*/
+class TransformTree
+{
+public:
+	std::vector<int>				parents;
+	std::vector<Mat4<float>>		locals;
+	std::vector<Mat4<float>>		worlds;
+	std::vector<unsigned char>		dirty;
+	std::vector<int>				firstChild;
+	std::vector<int>				nextSibling;
+	/* nodes whose local matrix changed, each once */
+	std::vector<int>				dirtyRoots;
+
+	TransformTree(void);
+	~TransformTree(void);
+
+	int								add(int const &parent, Mat4<float> const &local);
+	void							setLocal(int const &node, Mat4<float> const &local);
+	Mat4<float> const &				local(int const &node) const;
+	Mat4<float> const &				world(int const &node) const;
+	size_t							update(void);
+	size_t							size(void) const;
+	void							reserve(size_t const &count);
+	void							clear(void);
+
+private:
+	std::vector<int>				stack;
+
+	size_t							updateSubtree(int const &root);
+
+	TransformTree(TransformTree const &src);
+	TransformTree &					operator=(TransformTree const &rhs);
+};
+
+std::ostream						&operator<<(std::ostream &o, TransformTree const &i);
+
+#endif
@@ -13,6 +13,8 @@
 # endif
 
 # include "OpenCLWrapper.hpp"
+# include "MappedFile.hpp"
+# include "Pack.hpp"
 
 # include <cstring>
 # include <ostream>
@@ -23,14 +25,27 @@
 # include <fcntl.h>
 # include <unistd.h>
 # include <sstream>
+# include <stdint.h>
 
-# define BUFSIZE	4096
+/* 64-bit FNV-1a */
+# define FNV_OFFSET			(14695981039346656037ULL)
+# define FNV_PRIME			(1099511628211ULL)
 
-char *				readFile(char const *filename);
 float				getProb(void);
 int					printError(std::ostream &msg, int const &code);
 int					printError(std::string const &msg, int const &code);
 void *				printError(std::string const &msg);
-std::string			getFileContents(std::string const &filename);
+bool				cacheIsFresh(std::string const &source, std::string const &cache);
+/* FNV-1a of data chained to h, FNV_OFFSET to start */
+uint64_t			fnv1a(void const *data, size_t const &size, uint64_t const &h);
+/* loop over short writes, 0 on error */
+int					writeAll(int const &fd, void const *buf, size_t size);
+int					pwriteAll(int const &fd, void const *buf, size_t size, uint64_t offset);
+/* a file written whole or not at all, see Utils.cpp */
+int					openTemp(char const *filename, std::string &tmp);
+int					closeTemp(int const &fd, std::string const &tmp, char const *filename,
+						bool const &written);
+/* in GlUtils.cpp, so the tools linking Utils.o do not need GL */
+bool				hasGlExtension(char const *extension);
 
 #endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 # include <iostream>
 # include <math.h>
+# include "FastMath.hpp"
 
 template<typename TYPE>
 class Vec3
@@ -13,35 +14,23 @@ public:
 	TYPE				y;
 	TYPE				z;
 
-	Vec3(void) : x(0), y(0), z(0)
+	constexpr Vec3(void) : x(0), y(0), z(0)
 	{
-		return ;
 	}
 
-	Vec3(TYPE const &x, TYPE const &y, TYPE const &z) : x(x), y(y), z(z)
+	constexpr Vec3(TYPE const &x, TYPE const &y, TYPE const &z) : x(x), y(y), z(z)
 	{
-		return ;
 	}
 
-	Vec3(Vec3<TYPE> const &src) : x(src.x), y(src.y), z(src.z)
-	{
-		return ;
-	}
-
-	~Vec3(void)
-	{
-		return ;
-	}
+	Vec3(Vec3<TYPE> const &src) = default;
+	~Vec3(void) = default;
 
-	Vec3<TYPE>
+	constexpr Vec3<TYPE>
 	crossProduct(Vec3<TYPE> const &v) const
 	{
-		Vec3<TYPE>	r;
-
-		r.x = this->y * v.z - this->z * v.y;
-		r.y = this->z * v.x - this->x * v.z;
-		r.z = this->x * v.y - this->y * v.x;
-		return (r);
+		return (Vec3<TYPE>(this->y * v.z - this->z * v.y,
+							this->z * v.x - this->x * v.z,
+							this->x * v.y - this->y * v.x));
 	}
 
 	void
@@ -52,20 +41,21 @@ public:
 		this->z = a.x * b.y - b.x * a.y;
 	}
 
-	TYPE
+	constexpr TYPE
 	dotProduct(Vec3<TYPE> const &v) const
 	{
 		return (this->x * v.x + this->y * v.y + this->z * v.z);
 	}
 
+	template<typename MATH = PreciseMath>
 	void
 	normalize(void)
 	{
-		TYPE const	h = sqrt(this->x * this->x + this->y * this->y + this->z * this->z);
+		TYPE const	h = MATH::rsqrt(this->x * this->x + this->y * this->y + this->z * this->z);
 
-		this->x = this->x / h;
-		this->y = this->y / h;
-		this->z = this->z / h;
+		this->x *= h;
+		this->y *= h;
+		this->z *= h;
 	}
 
 	void
@@ -85,43 +75,34 @@ public:
 	}
 
 	Vec3<TYPE> &
-	operator=(Vec3<TYPE> const &rhs)
-	{
-		if (this != &rhs)
-		{
-			this->x = rhs.x;
-			this->y = rhs.y;
-			this->z = rhs.z;
-		}
-		return (*this);
-	}
+	operator=(Vec3<TYPE> const &rhs) = default;
 
-	Vec3<TYPE>
+	constexpr Vec3<TYPE>
 	operator+(Vec3<TYPE> const &rhs) const
 	{
 		return (Vec3<TYPE>(this->x + rhs.x, this->y + rhs.y, this->z + rhs.z));
 	}
 
-	Vec3<TYPE>
+	constexpr Vec3<TYPE>
 	operator-(Vec3<TYPE> const &rhs) const
 	{
 		return (Vec3<TYPE>(this->x - rhs.x, this->y - rhs.y, this->z - rhs.z));
 	}
 
-	Vec3<TYPE>
-	operator-()
+	constexpr Vec3<TYPE>
+	operator-() const
 	{
 		return (Vec3<TYPE>(-this->x, -this->y, -this->z));
 	}
 
-	Vec3<TYPE>
+	constexpr Vec3<TYPE>
 	operator*(Vec3<TYPE> const &rhs) const
 	{
 		return (Vec3<TYPE>(this->x * rhs.x, this->y * rhs.y, this->z * rhs.z));
 	}
 
-	Vec3<TYPE>
-	operator*(TYPE const &rhs)
+	constexpr Vec3<TYPE>
+	operator*(TYPE const &rhs) const
 	{
 		return (Vec3<TYPE>(this->x * rhs, this->y * rhs, this->z * rhs));
 	}
@@ -0,0 +1,68 @@
+#ifndef VEC3ARRAY_HPP
+# define VEC3ARRAY_HPP
+
+# include <cstddef>
+# include "Vec3.hpp"
+# include "Mat4.hpp"
+
+/*
+** Structure-of-arrays storage for single precision vectors: all x, then all
+** y, then all z, each array 32-byte aligned and padded to a multiple of
+** VEC3ARRAY_PAD elements. Operations work on whole arrays with SIMD;
+** those taking other arrays stop at the shortest one, elements of this
+** past it are left as they are.
+*/
+
+# define VEC3ARRAY_ALIGN		(32)
+# define VEC3ARRAY_PAD			(8)
+
+class Vec3Array
+{
+public:
+	float *				x;
+	float *				y;
+	float *				z;
+	size_t				size;
+	size_t				capacity;
+
+	Vec3Array(void);
+	Vec3Array(size_t const &size);
+	~Vec3Array(void);
+
+	int					reserve(size_t const &capacity);
+	int					resize(size_t const &size);
+	void				clear(void);
+
+	Vec3<float>			get(size_t const &i) const;
+	void				set(size_t const &i, Vec3<float> const &v);
+	void				fill(Vec3<float> const &v);
+
+	/* this[i] = this[i] + rhs[i] */
+	void				add(Vec3Array const &rhs);
+	/* this[i] = this[i] - rhs[i] */
+	void				sub(Vec3Array const &rhs);
+	/* this[i] = this[i] * s */
+	void				scale(float const &s);
+	/* this[i] = this[i] + rhs[i] * s */
+	void				addScaled(Vec3Array const &rhs, float const &s);
+	/* out[i] = this[i] . rhs[i] */
+	void				dot(Vec3Array const &rhs, float *out) const;
+	/* this[i] = a[i] x b[i] */
+	void				cross(Vec3Array const &a, Vec3Array const &b);
+	/* out[i] = |this[i]| */
+	void				length(float *out) const;
+	/* this[i] = this[i] / |this[i]| */
+	void				normalize(void);
+	/* same, with FastMath rsqrt (relative error < 5e-7) */
+	void				normalizeFast(void);
+	/* this[i] = m * (this[i], 1) */
+	void				transform(Mat4<float> const &m);
+
+private:
+	Vec3Array(Vec3Array const &src);
+	Vec3Array &			operator=(Vec3Array const &rhs);
+};
+
+std::ostream			&operator<<(std::ostream &o, Vec3Array const &i);
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef VEC3EXPR_HPP
+# define VEC3EXPR_HPP
+
+# include <algorithm>
+# include <cstddef>
+# include "Vec3.hpp"
+# include "Vec3Array.hpp"
+
+/*
+** Expression templates for component-wise Vec3 arithmetic. Wrapping the
+** operands with lazy() builds an expression tree instead of temporaries,
+** and assign() evaluates it in a single pass:
+**
+**	assign(r, lazy(a) + lazy(b) * s - lazy(c));			// Vec3
+**	assign(pos, lazy(pos) + lazy(vel) * dt);			// Vec3Array, one loop
+**	assign(vel, lazy(vel) + lazy(gravity) * dt);		// a Vec3 is broadcast
+**
+** Every node is evaluated per component and per index, so the destination
+** may appear in the expression. An array is only read below its size:
+** assign() stops at the shortest array, destination included, as the
+** Vec3Array operations do. Only component-wise operations are
+** supported, a cross product would read other components of the
+** destination.
+*/
+
+template<typename E>
+class Vec3Expr
+{
+public:
+	E const &
+	self(void) const
+	{
+		return (static_cast<E const &>(*this));
+	}
+};
+
+/* terminals */
+
+template<typename TYPE>
+class Vec3Leaf : public Vec3Expr<Vec3Leaf<TYPE>>
+{
+public:
+	typedef TYPE				value_type;
+	Vec3<TYPE> const &			v;
+
+	explicit Vec3Leaf(Vec3<TYPE> const &v) : v(v)
+	{
+	}
+
+	/* a Vec3 is broadcast, it never limits the loop */
+	size_t	size(void) const { return (size_t(-1)); }
+	TYPE	x(size_t const &) const { return (v.x); }
+	TYPE	y(size_t const &) const { return (v.y); }
+	TYPE	z(size_t const &) const { return (v.z); }
+};
+
+class Vec3ArrayLeaf : public Vec3Expr<Vec3ArrayLeaf>
+{
+public:
+	typedef float				value_type;
+	float const *				ax;
+	float const *				ay;
+	float const *				az;
+	size_t const				n;
+
+	explicit Vec3ArrayLeaf(Vec3Array const &a) : ax(a.x), ay(a.y), az(a.z), n(a.size)
+	{
+	}
+
+	size_t	size(void) const { return (n); }
+	float	x(size_t const &i) const { return (ax[i]); }
+	float	y(size_t const &i) const { return (ay[i]); }
+	float	z(size_t const &i) const { return (az[i]); }
+};
+
+template<typename TYPE>
+inline Vec3Leaf<TYPE>
+lazy(Vec3<TYPE> const &v)
+{
+	return (Vec3Leaf<TYPE>(v));
+}
+
+inline Vec3ArrayLeaf
+lazy(Vec3Array const &a)
+{
+	return (Vec3ArrayLeaf(a));
+}
+
+/* nodes, operands are held by value, leaves only hold references */
+
+# define VEC3EXPR_BINARY(NAME, OP)												\
+template<typename L, typename R>												\
+class NAME : public Vec3Expr<NAME<L, R>>										\
+{																				\
+public:																			\
+	typedef typename L::value_type		value_type;								\
+	L const								l;										\
+	R const								r;										\
+																				\
+	NAME(L const &l, R const &r) : l(l), r(r)									\
+	{																			\
+	}																			\
+																				\
+	size_t		size(void) const { return (std::min(l.size(), r.size())); }		\
+	value_type	x(size_t const &i) const { return (l.x(i) OP r.x(i)); }			\
+	value_type	y(size_t const &i) const { return (l.y(i) OP r.y(i)); }			\
+	value_type	z(size_t const &i) const { return (l.z(i) OP r.z(i)); }			\
+};
+
+VEC3EXPR_BINARY(Vec3Add, +)
+VEC3EXPR_BINARY(Vec3Sub, -)
+VEC3EXPR_BINARY(Vec3Mul, *)
+
+# undef VEC3EXPR_BINARY
+
+template<typename E>
+class Vec3Scale : public Vec3Expr<Vec3Scale<E>>
+{
+public:
+	typedef typename E::value_type		value_type;
+	E const								e;
+	value_type const					s;
+
+	Vec3Scale(E const &e, value_type const &s) : e(e), s(s)
+	{
+	}
+
+	size_t		size(void) const { return (e.size()); }
+	value_type	x(size_t const &i) const { return (e.x(i) * s); }
+	value_type	y(size_t const &i) const { return (e.y(i) * s); }
+	value_type	z(size_t const &i) const { return (e.z(i) * s); }
+};
+
+template<typename E>
+class Vec3Neg : public Vec3Expr<Vec3Neg<E>>
+{
+public:
+	typedef typename E::value_type		value_type;
+	E const								e;
+
+	explicit Vec3Neg(E const &e) : e(e)
+	{
+	}
+
+	size_t		size(void) const { return (e.size()); }
+	value_type	x(size_t const &i) const { return (-e.x(i)); }
+	value_type	y(size_t const &i) const { return (-e.y(i)); }
+	value_type	z(size_t const &i) const { return (-e.z(i)); }
+};
+
+/* operators */
+
+template<typename L, typename R>
+inline Vec3Add<L, R>
+operator+(Vec3Expr<L> const &l, Vec3Expr<R> const &r)
+{
+	return (Vec3Add<L, R>(l.self(), r.self()));
+}
+
+template<typename L, typename R>
+inline Vec3Sub<L, R>
+operator-(Vec3Expr<L> const &l, Vec3Expr<R> const &r)
+{
+	return (Vec3Sub<L, R>(l.self(), r.self()));
+}
+
+template<typename L, typename R>
+inline Vec3Mul<L, R>
+operator*(Vec3Expr<L> const &l, Vec3Expr<R> const &r)
+{
+	return (Vec3Mul<L, R>(l.self(), r.self()));
+}
+
+template<typename E>
+inline Vec3Scale<E>
+operator*(Vec3Expr<E> const &e, typename E::value_type const &s)
+{
+	return (Vec3Scale<E>(e.self(), s));
+}
+
+template<typename E>
+inline Vec3Scale<E>
+operator*(typename E::value_type const &s, Vec3Expr<E> const &e)
+{
+	return (Vec3Scale<E>(e.self(), s));
+}
+
+template<typename E>
+inline Vec3Neg<E>
+operator-(Vec3Expr<E> const &e)
+{
+	return (Vec3Neg<E>(e.self()));
+}
+
+/* evaluation */
+
+template<typename TYPE, typename E>
+inline void
+assign(Vec3<TYPE> &dst, Vec3Expr<E> const &expr)
+{
+	E const &		e = expr.self();
+
+	dst.x = e.x(0);
+	dst.y = e.y(0);
+	dst.z = e.z(0);
+}
+
+/*
+** One loop per component keeps each pass a plain stream over three
+** arrays, which the compiler vectorizes like a hand-written loop.
+*/
+template<typename E>
+inline void
+assign(Vec3Array &dst, Vec3Expr<E> const &expr)
+{
+	E const &		e = expr.self();
+	size_t const	n = std::min(dst.size, e.size());
+	float *			out;
+	size_t			i;
+
+	out = dst.x;
+	i = 0;
+	while (i < n)
+	{
+		out[i] = e.x(i);
+		++i;
+	}
+	out = dst.y;
+	i = 0;
+	while (i < n)
+	{
+		out[i] = e.y(i);
+		++i;
+	}
+	out = dst.z;
+	i = 0;
+	while (i < n)
+	{
+		out[i] = e.z(i);
+		++i;
+	}
+}
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef VIRTUALTEXTURE_HPP
+# define VIRTUALTEXTURE_HPP
+
+# include <atomic>
+# include <deque>
+# include <mutex>
+# include <condition_variable>
+# include <string>
+# include <unordered_map>
+# include <vector>
+# include <stdint.h>
+# include "Utils.hpp"
+# include "Bmp.hpp"
+# include "ThreadPool.hpp"
+# include "AssetIO.hpp"
+
+# define VT_E1					("Error opening virtual texture")
+# define VT_E2					("Bad virtual texture header!")
+# define VT_E3					("Failed to write virtual texture")
+
+/* "VTX1" */
+# define VT_MAGIC				(0x31585456)
+# define VT_VERSION				(1)
+# define VT_MAX_LEVELS			(16)
+# define VT_EXTENSION			(".vt")
+
+/*
+** Page content and border in texels, a stored page is VT_SLOT_SIZE on a
+** side. The border lets the atlas be sampled bilinearly without seams.
+** virtual_texture.gls has the same values.
+*/
+# define VT_PAGE_SIZE			(128)
+# define VT_BORDER				(4)
+# define VT_SLOT_SIZE			(VT_PAGE_SIZE + 2 * VT_BORDER)
+# define VT_PAGE_BYTES			((size_t)VT_SLOT_SIZE * VT_SLOT_SIZE * 4)
+
+/* atlas side in pages, 16 x 16 pages of 136 x 136 texels is 18 MB */
+# define VT_ATLAS_PAGES			(16)
+/* the feedback pass renders at 1 / VT_FEEDBACK_SCALE of the screen */
+# define VT_FEEDBACK_SCALE		(8)
+# define VT_FEEDBACK_BUFFERS	(2)
+/* page reads queued, and pages copied to the atlas, per update() */
+# define VT_REQUESTS_PER_FRAME	(32)
+# define VT_UPLOADS_PER_FRAME	(16)
+/* a page read is canceled once the page is not seen for this many frames */
+# define VT_STALE_FRAMES		(30)
+
+/*
+** Page file, little-endian:
+**
+**	VtHeader
+**	VtLevel[levels]				largest first
+**	pages						VT_PAGE_BYTES each, RGBA rows bottom
+**								first, border included; level by level,
+**								row by row of pages, bottom row first
+*/
+struct VtHeader
+{
+	uint32_t			magic;
+	uint32_t			version;
+	uint32_t			width;
+	uint32_t			height;
+	uint32_t			levels;
+	uint32_t			pageSize;
+	uint32_t			border;
+	uint32_t			reserved;
+};
+
+struct VtLevel
+{
+	uint32_t			width;
+	uint32_t			height;
+	uint32_t			pagesX;
+	uint32_t			pagesY;
+	/* of the first page, from the start of the file */
+	uint64_t			offset;
+};
+
+/*
+** Texture larger than video memory, of which only the pages seen on
+** screen are resident:
+**
+**	- the image is cooked once, from the bmp streamed band by band, into
+**	  filename.bmp.vt: each mip level split in VT_PAGE_SIZE pages with
+**	  their border, level n being max(1, width >> n) x max(1, height >> n)
+**	  like a GL mip chain, down to a level that fits in one page;
+**	- resident pages live in an atlas of VT_ATLAS_PAGES x VT_ATLAS_PAGES
+**	  slots, the only large allocation, whatever the image size;
+**	- the page table, one RGBA8UI texel per page and a mip level per
+**	  level, holds the slot and level of the finest resident page covering
+**	  each page; the last level is never evicted, so every lookup resolves;
+**	- shaders render a feedback pass of the pages they would sample into a
+**	  small R32UI target, read back asynchronously through pixel buffers;
+**	- update() turns the feedback into AssetIO page reads, coarse levels
+**	  first, cancels those no longer seen and copies finished pages into
+**	  the least recently seen slots.
+**
+** Usage, on the GL thread, shaders linked with virtual_texture.gls:
+**
+**	vt.init("world.bmp", width, height);
+**	each frame:
+**		vt.update();
+**		if (vt.beginFeedback())
+**		{
+**			vt.bind(feedbackProgram, 1, 2, true);	// + vt_feedback.gls
+**			draw the scene
+**			vt.endFeedback();
+**		}
+**		vt.bind(program, 1, 2, false);				// vtSample(uv)
+**		draw the scene
+**
+** Nothing is drawn from the virtual texture until the page file is cooked
+** (on the pool, if missing or stale) and its last level loaded.
+*/
+class VirtualTexture
+{
+public:
+	/* the page file is cooked on pool, pages are read through io */
+	VirtualTexture(ThreadPool &pool, AssetIO &io);
+	~VirtualTexture(void);
+
+	/* screen size, the feedback target is VT_FEEDBACK_SCALE times smaller */
+	int						init(char const *filename, int const &screenWidth,
+								int const &screenHeight);
+	void					update(void);
+	/* 0 while not ready, the feedback pass is then skipped */
+	int						beginFeedback(void);
+	void					endFeedback(void);
+	/* binds the page table and the atlas to two texture units, program in use */
+	void					bind(GLuint const &program, GLint const &tableUnit,
+								GLint const &atlasUnit, bool const &feedback) const;
+	bool					ready(void) const;
+	/* pages in the atlas */
+	uint32_t				resident(void) const;
+
+	static int				cook(char const *bmp, char const *filename);
+
+private:
+	enum
+	{
+		PAGE_ABSENT,
+		PAGE_LOADING,
+		PAGE_RESIDENT
+	};
+
+	struct Load
+	{
+		uint32_t			page;
+		unsigned char *		pixels;
+	};
+
+	struct Slot
+	{
+		int32_t				page;
+		/* last frame the page was seen in the feedback */
+		uint64_t			used;
+	};
+
+	ThreadPool &			pool;
+	AssetIO &				io;
+	std::string				path;
+	int						fd;
+	VtHeader				header;
+	VtLevel					levels[VT_MAX_LEVELS];
+	/* index of the first page of each level */
+	uint32_t				firstPage[VT_MAX_LEVELS];
+	std::vector<unsigned char>	states;
+	std::vector<int32_t>	slotOf;
+	std::vector<uint64_t>	seen;
+	std::vector<Slot>		slots;
+	/* page table, tableWidth >> n by tableHeight >> n entries for level n */
+	std::vector<uint32_t>	table[VT_MAX_LEVELS];
+	uint32_t				tableWidth;
+	uint32_t				tableHeight;
+	/* x0, y0, x1, y1 of the entries to upload, per level */
+	uint32_t				dirty[VT_MAX_LEVELS][4];
+	uint64_t				frame;
+
+	GLuint					tableTexture;
+	GLuint					atlasTexture;
+	GLuint					fbo;
+	GLuint					feedbackColor;
+	GLuint					feedbackDepth;
+	GLuint					pbos[VT_FEEDBACK_BUFFERS];
+	GLsync					fences[VT_FEEDBACK_BUFFERS];
+	size_t					current;
+	int						feedbackWidth;
+	int						feedbackHeight;
+	GLint					savedFbo;
+	GLint					savedViewport[4];
+
+	/* 0 while cooking, 1 once cooked, -1 if it failed */
+	std::atomic<int>		cooked;
+	bool					opened;
+	std::mutex				mutex;
+	std::condition_variable	cond;
+	std::deque<Load>		loaded;
+	size_t					inFlight;
+	/* pages being read, only touched on the GL thread */
+	std::unordered_map<uint32_t, AssetIO::Ticket>	reads;
+
+	int						openPages(void);
+	int						openGl(void);
+	void					readFeedback(void);
+	void					parseFeedback(uint32_t const *texels, size_t const &count);
+	void					load(uint32_t const &page);
+	void					complete(Load done, ssize_t const &size);
+	void					place(Load const &done);
+	int32_t					allocate(void);
+	void					evict(int32_t const &slot);
+	void					refresh(uint32_t const &level, uint32_t const &x, uint32_t const &y);
+	void					uploadTable(void);
+	uint32_t				levelOf(uint32_t const &page) const;
+	int						readPage(uint32_t const &page, unsigned char *pixels) const;
+
+	VirtualTexture(VirtualTexture const &src);
+	VirtualTexture &		operator=(VirtualTexture const &rhs);
+};
+
+#endif
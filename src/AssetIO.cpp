@@ -0,0 +1,474 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "AssetIO.hpp"
+#if defined(ASSET_IO_URING)
+# include <linux/io_uring.h>
+#endif
+
+/* user_data of the ring entries that are not reads */
+#define CANCEL_TAG			(1ULL << 63)
+#define WAKE_TAG			(~0ULL)
+
+bool
+AssetIO::Order::operator()(Request const *a, Request const *b) const
+{
+	if (a->priority != b->priority)
+		return (a->priority > b->priority);
+	return (a->ticket < b->ticket);
+}
+
+AssetIO::AssetIO(ThreadPool &pool)
+	: pool(pool), next(1), active(0), outstanding(0), ringFd(-1), sqRing(0), cqRing(0),
+	sqRingSize(0), cqRingSize(0), sqesSize(0), sqes(0), sqHead(0), sqTail(0), sqMask(0),
+	sqArray(0), cqHead(0), cqTail(0), cqMask(0), cqes(0)
+{
+	depth = pool.size() > 1 ? pool.size() / 2 : 1;
+	return ;
+}
+
+/*
+** Every read is canceled and its completion run before the ring goes
+** away, so no buffer is written after this returns.
+*/
+AssetIO::~AssetIO(void)
+{
+	std::vector<Ticket>		tickets;
+	std::unordered_map<Ticket, Request *>::iterator	it;
+	size_t					i;
+
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		it = requests.begin();
+		while (it != requests.end())
+			tickets.push_back((it++)->first);
+	}
+	i = 0;
+	while (i < tickets.size())
+		cancel(tickets[i++]);
+	finish();
+	if (ringFd != -1)
+	{
+		{
+			std::lock_guard<std::mutex>		lock(mutex);
+			Finished						finished;
+
+			prepare(0, WAKE_TAG);
+			flush(finished);
+		}
+		reaper.join();
+		closeRing();
+	}
+	return ;
+}
+
+int
+AssetIO::init(void)
+{
+	if (ringFd != -1 || !setupRing())
+		return (ringFd != -1);
+	depth = ASSET_IO_DEPTH;
+	reaper = std::thread(&AssetIO::reap, this);
+	return (1);
+}
+
+bool
+AssetIO::uring(void) const
+{
+	return (ringFd != -1);
+}
+
+AssetIO::Ticket
+AssetIO::read(int const &fd, void *buffer, size_t const &size, uint64_t const &offset,
+			int const &priority, Completion const &done)
+{
+	Finished		finished;
+	Request			*request;
+	Ticket			ticket;
+
+	request = new Request();
+	request->priority = priority;
+	request->fd = fd;
+	request->buffer = (unsigned char *)buffer;
+	request->size = size;
+	request->offset = offset;
+	request->done = 0;
+	request->canceled = false;
+	request->completion = done;
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		ticket = next++;
+		request->ticket = ticket;
+		requests[ticket] = request;
+		queued.insert(request);
+		++outstanding;
+		dispatch(finished);
+	}
+	deliver(finished);
+	return (ticket);
+}
+
+/*
+** A queued read completes right away. One in flight is flagged, and on
+** the ring also canceled in the kernel: it completes with -ECANCELED
+** whether or not the kernel got to it first.
+*/
+bool
+AssetIO::cancel(Ticket const &ticket)
+{
+	std::unordered_map<Ticket, Request *>::iterator	it;
+	Finished		finished;
+	Request			*request;
+
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		it = requests.find(ticket);
+		if (it == requests.end())
+			return (false);
+		request = it->second;
+		if (!request->canceled)
+		{
+			request->canceled = true;
+			if (queued.erase(request) != 0)
+				complete(request, -ECANCELED, finished);
+			else if (ringFd != -1)
+			{
+				prepare(0, CANCEL_TAG | ticket);
+				flush(finished);
+			}
+		}
+	}
+	deliver(finished);
+	return (true);
+}
+
+void
+AssetIO::finish(void)
+{
+	std::unique_lock<std::mutex>	lock(mutex);
+
+	while (outstanding != 0)
+		cond.wait(lock);
+}
+
+size_t
+AssetIO::pending(void)
+{
+	std::lock_guard<std::mutex>		lock(mutex);
+
+	return (outstanding);
+}
+
+/* with the lock held, the reads started on the ring go in one system call */
+void
+AssetIO::dispatch(Finished &finished)
+{
+	Request			*request;
+
+	while (active < depth && !queued.empty())
+	{
+		request = *queued.begin();
+		queued.erase(queued.begin());
+		++active;
+		start(request);
+	}
+	if (ringFd != -1)
+		flush(finished);
+}
+
+/* with the lock held, starts or resumes a read, on the ring once flushed */
+void
+AssetIO::start(Request *request)
+{
+	if (ringFd == -1)
+	{
+		pool.submit([this, request]() { run(request); });
+		return ;
+	}
+	request->iov.iov_base = request->buffer + request->done;
+	request->iov.iov_len = request->size - request->done;
+	prepare(request, request->ticket);
+}
+
+/* pool fallback, on a worker */
+void
+AssetIO::run(Request *request)
+{
+	Finished		finished;
+	ssize_t			n;
+	bool			canceled;
+
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		canceled = request->canceled;
+	}
+	n = 0;
+	while (!canceled && request->done < request->size)
+	{
+		n = pread(request->fd, request->buffer + request->done, request->size - request->done,
+				request->offset + request->done);
+		if (n == -1 && errno == EINTR)
+			continue ;
+		if (n <= 0)
+			break ;
+		request->done += n;
+	}
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		--active;
+		complete(request, n == -1 ? -errno : (ssize_t)request->done, finished);
+		dispatch(finished);
+	}
+	deliver(finished);
+}
+
+/* with the lock held, the completion runs later in deliver() */
+void
+AssetIO::complete(Request *request, ssize_t const &result, Finished &finished)
+{
+	requests.erase(request->ticket);
+	finished.push_back(std::make_pair(request, request->canceled ? -ECANCELED : result));
+}
+
+/* without the lock */
+void
+AssetIO::deliver(Finished &finished)
+{
+	size_t			i;
+
+	if (finished.empty())
+		return ;
+	i = 0;
+	while (i < finished.size())
+	{
+		finished[i].first->completion(finished[i].second);
+		delete finished[i].first;
+		++i;
+	}
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		outstanding -= finished.size();
+		cond.notify_all();
+	}
+	finished.clear();
+}
+
+#if defined(ASSET_IO_URING) && defined(__NR_io_uring_setup)
+
+/*
+** The ring is set up with raw system calls, liburing is not needed.
+** READV rather than READ keeps it working on 5.1 kernels.
+*/
+int
+AssetIO::setupRing(void)
+{
+	struct io_uring_params	p;
+
+	std::memset(&p, 0, sizeof(p));
+	if ((ringFd = syscall(__NR_io_uring_setup, ASSET_IO_DEPTH * 2, &p)) < 0)
+		return (ringFd = -1, 0);
+	sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		sqRingSize = std::max(sqRingSize, cqRingSize);
+		cqRingSize = sqRingSize;
+	}
+	sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+	sqRing = mmap(0, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ringFd, IORING_OFF_SQ_RING);
+	cqRing = sqRing;
+	if (sqRing != MAP_FAILED && !(p.features & IORING_FEAT_SINGLE_MMAP))
+		cqRing = mmap(0, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					ringFd, IORING_OFF_CQ_RING);
+	sqes = mmap(0, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ringFd, IORING_OFF_SQES);
+	if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED)
+		return (closeRing(), 0);
+	sqHead = (unsigned *)((char *)sqRing + p.sq_off.head);
+	sqTail = (unsigned *)((char *)sqRing + p.sq_off.tail);
+	sqMask = (unsigned *)((char *)sqRing + p.sq_off.ring_mask);
+	sqArray = (unsigned *)((char *)sqRing + p.sq_off.array);
+	cqHead = (unsigned *)((char *)cqRing + p.cq_off.head);
+	cqTail = (unsigned *)((char *)cqRing + p.cq_off.tail);
+	cqMask = (unsigned *)((char *)cqRing + p.cq_off.ring_mask);
+	cqes = (char *)cqRing + p.cq_off.cqes;
+	return (1);
+}
+
+void
+AssetIO::closeRing(void)
+{
+	if (sqes != 0 && sqes != MAP_FAILED)
+		munmap(sqes, sqesSize);
+	if (cqRing != 0 && cqRing != MAP_FAILED && cqRing != sqRing)
+		munmap(cqRing, cqRingSize);
+	if (sqRing != 0 && sqRing != MAP_FAILED)
+		munmap(sqRing, sqRingSize);
+	close(ringFd);
+	ringFd = -1;
+	sqRing = 0;
+	cqRing = 0;
+	sqes = 0;
+}
+
+/*
+** With the lock held, queues an entry for the next flush(). Without
+** request, cancels the read whose ticket is in data or, for WAKE_TAG,
+** wakes the reaper. The kernel consumes the entries during
+** io_uring_enter(), so the ring never fills: at most ASSET_IO_DEPTH reads
+** plus their cancels are pending.
+*/
+void
+AssetIO::prepare(Request *request, uint64_t const &data)
+{
+	struct io_uring_sqe	*sqe;
+	unsigned const		tail = *sqTail;
+	unsigned const		index = tail & *sqMask;
+
+	sqe = (struct io_uring_sqe *)sqes + index;
+	std::memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = data;
+	if (request != 0)
+	{
+		sqe->opcode = IORING_OP_READV;
+		sqe->fd = request->fd;
+		sqe->addr = (uint64_t)&request->iov;
+		sqe->len = 1;
+		sqe->off = request->offset + request->done;
+	}
+	else if (data != WAKE_TAG)
+	{
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = data & ~CANCEL_TAG;
+	}
+	else
+		sqe->opcode = IORING_OP_NOP;
+	sqArray[index] = index;
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+** With the lock held, submits every prepared entry in one io_uring_enter().
+** The entries the kernel refused are taken back and their reads fail.
+*/
+void
+AssetIO::flush(Finished &finished)
+{
+	struct io_uring_sqe	*sqe;
+	std::unordered_map<Ticket, Request *>::iterator	it;
+	unsigned			head;
+	unsigned const		tail = *sqTail;
+	long				ret;
+	int					error;
+
+	ret = 0;
+	while ((head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE)) != tail)
+	{
+		ret = syscall(__NR_io_uring_enter, ringFd, tail - head, 0, 0, NULL, 0);
+		if (ret == 0 || (ret == -1 && errno != EINTR))
+			break ;
+	}
+	if (head == tail)
+		return ;
+	error = ret == 0 ? EAGAIN : errno;
+	while (head != tail)
+	{
+		sqe = (struct io_uring_sqe *)sqes + (head++ & *sqMask);
+		if ((sqe->user_data & CANCEL_TAG)
+			|| (it = requests.find(sqe->user_data)) == requests.end())
+			continue ;
+		--active;
+		complete(it->second, -error, finished);
+	}
+	__atomic_store_n(sqTail, *sqHead, __ATOMIC_RELEASE);
+}
+
+/*
+** Reaper thread: waits for completions, resumes short reads and starts
+** the queued reads that now fit, then runs the completions unlocked.
+*/
+void
+AssetIO::reap(void)
+{
+	struct io_uring_cqe	*cqe;
+	Finished		finished;
+	std::unordered_map<Ticket, Request *>::iterator	it;
+	Request			*request;
+	unsigned		head;
+	unsigned		tail;
+	bool			stop;
+
+	stop = false;
+	while (!stop)
+	{
+		syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		{
+			std::lock_guard<std::mutex>		lock(mutex);
+
+			head = *cqHead;
+			tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+			while (head != tail)
+			{
+				cqe = (struct io_uring_cqe *)cqes + (head++ & *cqMask);
+				stop = stop || cqe->user_data == WAKE_TAG;
+				if ((cqe->user_data & CANCEL_TAG)
+					|| (it = requests.find(cqe->user_data)) == requests.end())
+					continue ;
+				request = it->second;
+				if (cqe->res > 0 && !request->canceled
+					&& request->done + cqe->res < request->size)
+				{
+					request->done += cqe->res;
+					start(request);
+					continue ;
+				}
+				--active;
+				complete(request, cqe->res < 0 ? cqe->res : request->done + cqe->res, finished);
+			}
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+			dispatch(finished);
+		}
+		deliver(finished);
+	}
+}
+
+#else
+
+int
+AssetIO::setupRing(void)
+{
+	return (0);
+}
+
+void
+AssetIO::closeRing(void)
+{
+}
+
+void
+AssetIO::prepare(Request *, uint64_t const &)
+{
+}
+
+void
+AssetIO::flush(Finished &)
+{
+}
+
+void
+AssetIO::reap(void)
+{
+}
+
+#endif
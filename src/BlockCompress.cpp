@@ -0,0 +1,474 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Simd.hpp"
+#include "BlockCompress.hpp"
+
+static inline int
+quantize(float const &v, int const &max)
+{
+	int const		q = (int)(v * max / 255.0f + 0.5f);
+
+	return (q < 0 ? 0 : (q > max ? max : q));
+}
+
+static inline uint16_t
+pack565(float const *c)
+{
+	return ((uint16_t)((quantize(c[0], 31) << 11) | (quantize(c[1], 63) << 5) | quantize(c[2], 31)));
+}
+
+static inline void
+unpack565(uint16_t const &v, float *c)
+{
+	int const		r = (v >> 11) & 31;
+	int const		g = (v >> 5) & 63;
+	int const		b = v & 31;
+
+	c[0] = (float)((r << 3) | (r >> 2));
+	c[1] = (float)((g << 2) | (g >> 4));
+	c[2] = (float)((b << 3) | (b >> 2));
+}
+
+/*
+** Nearest palette entry for each pixel, 2 bits per pixel, pixel 0 in the
+** low bits. Returns the squared error in err.
+*/
+static uint32_t
+fitIndices(float const *r, float const *g, float const *b, float const pal[4][3], float &err)
+{
+	uint32_t		bits;
+	int				i;
+
+	bits = 0;
+	err = 0;
+	i = 0;
+#if defined(SIMD_SSE2)
+	alignas(SIMD_ALIGN) int	idx[4];
+	alignas(SIMD_ALIGN) float	sum[4];
+	__m128			vr;
+	__m128			vg;
+	__m128			vb;
+	__m128			best;
+	__m128			d;
+	__m128			t;
+	__m128			mask;
+	__m128i			vi;
+	__m128			acc;
+	int				k;
+
+	acc = _mm_setzero_ps();
+	while (i < 16)
+	{
+		vr = _mm_load_ps(r + i);
+		vg = _mm_load_ps(g + i);
+		vb = _mm_load_ps(b + i);
+		best = _mm_set1_ps(1e30f);
+		vi = _mm_setzero_si128();
+		k = 0;
+		while (k < 4)
+		{
+			t = _mm_sub_ps(vr, _mm_set1_ps(pal[k][0]));
+			d = _mm_mul_ps(t, t);
+			t = _mm_sub_ps(vg, _mm_set1_ps(pal[k][1]));
+			d = _mm_add_ps(d, _mm_mul_ps(t, t));
+			t = _mm_sub_ps(vb, _mm_set1_ps(pal[k][2]));
+			d = _mm_add_ps(d, _mm_mul_ps(t, t));
+			mask = _mm_cmplt_ps(d, best);
+			best = _mm_min_ps(d, best);
+			vi = _mm_or_si128(_mm_andnot_si128(_mm_castps_si128(mask), vi),
+							_mm_and_si128(_mm_castps_si128(mask), _mm_set1_epi32(k)));
+			++k;
+		}
+		acc = _mm_add_ps(acc, best);
+		_mm_store_si128((__m128i *)idx, vi);
+		bits |= (uint32_t)(idx[0] | (idx[1] << 2) | (idx[2] << 4) | (idx[3] << 6)) << (i * 2);
+		i += 4;
+	}
+	_mm_store_ps(sum, acc);
+	err = sum[0] + sum[1] + sum[2] + sum[3];
+#else
+	float			best;
+	float			d;
+	int				k;
+	int				n;
+
+	while (i < 16)
+	{
+		best = 1e30f;
+		n = 0;
+		k = 0;
+		while (k < 4)
+		{
+			d = (r[i] - pal[k][0]) * (r[i] - pal[k][0]) + (g[i] - pal[k][1]) * (g[i] - pal[k][1])
+				+ (b[i] - pal[k][2]) * (b[i] - pal[k][2]);
+			if (d < best)
+			{
+				best = d;
+				n = k;
+			}
+			++k;
+		}
+		err += best;
+		bits |= (uint32_t)n << (i * 2);
+		++i;
+	}
+#endif
+	return (bits);
+}
+
+static void
+palette(uint16_t const &c0, uint16_t const &c1, float pal[4][3])
+{
+	int				c;
+
+	unpack565(c0, pal[0]);
+	unpack565(c1, pal[1]);
+	c = 0;
+	while (c < 3)
+	{
+		pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+		pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+		++c;
+	}
+}
+
+/*
+** Least squares endpoints for fixed indices: each pixel is w * a +
+** (1 - w) * b with w in {1, 0, 2/3, 1/3}. Returns false if the system is
+** singular (all pixels on one palette entry).
+*/
+static bool
+refine(float const *r, float const *g, float const *b, uint32_t const &bits,
+		float *a, float *e)
+{
+	static float const	weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float			aa;
+	float			ab;
+	float			bb;
+	float			ax[3];
+	float			bx[3];
+	float			w;
+	float			det;
+	int				i;
+	int				c;
+
+	aa = 0;
+	ab = 0;
+	bb = 0;
+	std::memset(ax, 0, sizeof(ax));
+	std::memset(bx, 0, sizeof(bx));
+	i = 0;
+	while (i < 16)
+	{
+		w = weight[(bits >> (i * 2)) & 3];
+		aa += w * w;
+		ab += w * (1 - w);
+		bb += (1 - w) * (1 - w);
+		ax[0] += w * r[i];
+		ax[1] += w * g[i];
+		ax[2] += w * b[i];
+		bx[0] += (1 - w) * r[i];
+		bx[1] += (1 - w) * g[i];
+		bx[2] += (1 - w) * b[i];
+		++i;
+	}
+	det = aa * bb - ab * ab;
+	if (std::fabs(det) < 1e-6f)
+		return (false);
+	c = 0;
+	while (c < 3)
+	{
+		a[c] = (ax[c] * bb - bx[c] * ab) / det;
+		e[c] = (bx[c] * aa - ax[c] * ab) / det;
+		++c;
+	}
+	return (true);
+}
+
+/*
+** Always the four color mode (c0 > c1), which BC3 requires.
+*/
+static void
+colorBlock(unsigned char const *block, unsigned char *out)
+{
+	alignas(SIMD_ALIGN) float	r[16];
+	alignas(SIMD_ALIGN) float	g[16];
+	alignas(SIMD_ALIGN) float	b[16];
+	float			mean[3];
+	float			cov[6];
+	float			axis[3];
+	float			next[3];
+	float			lo[3];
+	float			hi[3];
+	float			pal[4][3];
+	float			t;
+	float			tmin;
+	float			tmax;
+	float			err;
+	float			err2;
+	uint16_t		c0;
+	uint16_t		c1;
+	uint16_t		n0;
+	uint16_t		n1;
+	uint16_t		tmp;
+	uint32_t		bits;
+	uint32_t		bits2;
+	int				i;
+
+	std::memset(mean, 0, sizeof(mean));
+	i = 0;
+	while (i < 16)
+	{
+		r[i] = block[i * 4];
+		g[i] = block[i * 4 + 1];
+		b[i] = block[i * 4 + 2];
+		mean[0] += r[i];
+		mean[1] += g[i];
+		mean[2] += b[i];
+		++i;
+	}
+	mean[0] /= 16;
+	mean[1] /= 16;
+	mean[2] /= 16;
+	std::memset(cov, 0, sizeof(cov));
+	i = 0;
+	while (i < 16)
+	{
+		lo[0] = r[i] - mean[0];
+		lo[1] = g[i] - mean[1];
+		lo[2] = b[i] - mean[2];
+		cov[0] += lo[0] * lo[0];
+		cov[1] += lo[0] * lo[1];
+		cov[2] += lo[0] * lo[2];
+		cov[3] += lo[1] * lo[1];
+		cov[4] += lo[1] * lo[2];
+		cov[5] += lo[2] * lo[2];
+		++i;
+	}
+	/* principal axis by power iteration, luminance as the starting guess */
+	axis[0] = 0.299f;
+	axis[1] = 0.587f;
+	axis[2] = 0.114f;
+	i = 0;
+	while (i < 4)
+	{
+		next[0] = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		next[1] = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		next[2] = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		t = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+		if (t < 1e-6f)
+			break ;
+		axis[0] = next[0] / t;
+		axis[1] = next[1] / t;
+		axis[2] = next[2] / t;
+		++i;
+	}
+	tmin = 1e30f;
+	tmax = -1e30f;
+	i = 0;
+	while (i < 16)
+	{
+		t = (r[i] - mean[0]) * axis[0] + (g[i] - mean[1]) * axis[1] + (b[i] - mean[2]) * axis[2];
+		tmin = std::min(tmin, t);
+		tmax = std::max(tmax, t);
+		++i;
+	}
+	t = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	if (t > 0)
+	{
+		tmin /= t;
+		tmax /= t;
+	}
+	i = 0;
+	while (i < 3)
+	{
+		hi[i] = mean[i] + axis[i] * tmax;
+		lo[i] = mean[i] + axis[i] * tmin;
+		++i;
+	}
+	c0 = pack565(hi);
+	c1 = pack565(lo);
+	palette(c0, c1, pal);
+	bits = fitIndices(r, g, b, pal, err);
+	if (c0 != c1 && refine(r, g, b, bits, hi, lo))
+	{
+		n0 = pack565(hi);
+		n1 = pack565(lo);
+		palette(n0, n1, pal);
+		bits2 = fitIndices(r, g, b, pal, err2);
+		if (err2 < err)
+		{
+			c0 = n0;
+			c1 = n1;
+			bits = bits2;
+		}
+	}
+	if (c0 < c1)
+	{
+		tmp = c0;
+		c0 = c1;
+		c1 = tmp;
+		bits ^= 0x55555555;
+	}
+	else if (c0 == c1)
+		bits = 0;
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+	out[4] = bits & 0xFF;
+	out[5] = (bits >> 8) & 0xFF;
+	out[6] = (bits >> 16) & 0xFF;
+	out[7] = bits >> 24;
+}
+
+/*
+** Alpha block shared by BC3 (and BC4): eight level mode, a0 the block
+** maximum and a1 the minimum, so both extremes are exact.
+*/
+static void
+alphaBlock(unsigned char const *block, unsigned char *out)
+{
+	uint64_t		bits;
+	int				a0;
+	int				a1;
+	int				level;
+	int				i;
+
+	a0 = 0;
+	a1 = 255;
+	i = 0;
+	while (i < 16)
+	{
+		a0 = std::max(a0, (int)block[i * 4 + 3]);
+		a1 = std::min(a1, (int)block[i * 4 + 3]);
+		++i;
+	}
+	bits = 0;
+	if (a0 != a1)
+	{
+		i = 0;
+		while (i < 16)
+		{
+			level = ((block[i * 4 + 3] - a1) * 14 + (a0 - a1)) / ((a0 - a1) * 2);
+			/* level 7 is a0 (index 0), 0 is a1 (index 1), k is index 8 - k */
+			bits |= (uint64_t)(level == 7 ? 0 : (level == 0 ? 1 : 8 - level)) << (i * 3);
+			++i;
+		}
+	}
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	i = 0;
+	while (i < 6)
+	{
+		out[2 + i] = (unsigned char)(bits >> (i * 8));
+		++i;
+	}
+}
+
+void
+bc1Block(unsigned char const *block, unsigned char *out)
+{
+	colorBlock(block, out);
+}
+
+void
+bc3Block(unsigned char const *block, unsigned char *out)
+{
+	alphaBlock(block, out);
+	colorBlock(block, out + 8);
+}
+
+size_t
+bcSize(uint32_t const &width, uint32_t const &height, size_t const &blockSize)
+{
+	return ((size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize);
+}
+
+bool
+bcOpaque(unsigned char const *rgba, size_t const &count)
+{
+	size_t			i;
+
+	i = 0;
+	while (i < count)
+	{
+		if (rgba[i * 4 + 3] != 255)
+			return (false);
+		++i;
+	}
+	return (true);
+}
+
+/*
+** Copies the 4x4 block at (bx, by), clamping reads to the image.
+*/
+static inline void
+gatherBlock(unsigned char const *rgba, uint32_t const &width, uint32_t const &height,
+			uint32_t const &bx, uint32_t const &by, unsigned char *block)
+{
+	uint32_t		x;
+	uint32_t		y;
+	uint32_t		sx;
+	uint32_t		sy;
+
+	y = 0;
+	while (y < 4)
+	{
+		sy = std::min(by * 4 + y, height - 1);
+		if (bx * 4 + 3 < width)
+			std::memcpy(block + y * 16, rgba + ((size_t)sy * width + bx * 4) * 4, 16);
+		else
+		{
+			x = 0;
+			while (x < 4)
+			{
+				sx = std::min(bx * 4 + x, width - 1);
+				std::memcpy(block + y * 16 + x * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+				++x;
+			}
+		}
+		++y;
+	}
+}
+
+template<typename FUNC>
+static void
+compress(unsigned char const *rgba, uint32_t const &width, uint32_t const &height,
+		unsigned char *out, size_t const &blockSize, FUNC encode)
+{
+	uint32_t const	bw = (width + 3) / 4;
+	uint32_t const	bh = (height + 3) / 4;
+	unsigned char	block[64];
+	uint32_t		bx;
+	uint32_t		by;
+
+	by = 0;
+	while (by < bh)
+	{
+		bx = 0;
+		while (bx < bw)
+		{
+			gatherBlock(rgba, width, height, bx, by, block);
+			encode(block, out + ((size_t)by * bw + bx) * blockSize);
+			++bx;
+		}
+		++by;
+	}
+}
+
+void
+bc1Compress(unsigned char const *rgba, uint32_t const &width, uint32_t const &height,
+			unsigned char *out)
+{
+	compress(rgba, width, height, out, BC1_BLOCK_SIZE, bc1Block);
+}
+
+void
+bc3Compress(unsigned char const *rgba, uint32_t const &width, uint32_t const &height,
+			unsigned char *out)
+{
+	compress(rgba, width, height, out, BC3_BLOCK_SIZE, bc3Block);
+}
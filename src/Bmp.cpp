@@ -1,14 +1,21 @@
 
 #include "Bmp.hpp"
+#include "Swizzle.hpp"
 
 Bmp::Bmp(void)
 {
+	this->top_down = false;
+	this->colors = 0;
+	this->byte_aligned = false;
 	this->data = 0;
+	this->map = 0;
+	this->map_size = 0;
 	return ;
 }
 
 Bmp::~Bmp(void)
 {
+	closeFile();
 	if (this->data != 0)
 		delete [] this->data;
 	return ;
@@ -36,7 +43,7 @@ deserialize(unsigned char const *s, int o, int size)
 int
 Bmp::compressionSupported()
 {
-	static int const		support[CMP_MAX] = { 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	static int const		support[CMP_MAX] = { 1, 1, 1, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0 };
 /*	static char const		*msg[CMP_MAX] =
 	{
 		"BI_RGB",
@@ -55,7 +62,6 @@ Bmp::compressionSupported()
 		"BI_CMYKRLE4"
 	};*/
 
-	std::cerr << compression << std::endl;
 /*	std::cerr << msg[compression] << " compression method ";
 	if (support[compression])
 		std::cerr << "is supported";
@@ -65,115 +71,492 @@ Bmp::compressionSupported()
 	return (support[compression]);
 }
 
+static bool
+bppSupported(uint32_t const &compression, uint32_t const &bpp)
+{
+	if (compression == BI_RLE8)
+		return (bpp == 8);
+	if (compression == BI_RLE4)
+		return (bpp == 4);
+	if (compression == BI_BITFIELDS || compression == BI_ALPHABITFIELDS)
+		return (bpp == 16 || bpp == 32);
+	return (bpp == 1 || bpp == 4 || bpp == 8 || bpp == 16 || bpp == 24 || bpp == 32);
+}
+
 int
 Bmp::getBmpInfo(void)
 {
-	int					unused_header_size;
-	unsigned char		*unused_header;
+	uint64_t			row_size;
+	uint32_t			dib_size;
+	int32_t				h;
 
-	if (bmp_header[0] != 'B' && bmp_header[1] != 'M')
+	if (bmp_header[0] != 'B' || bmp_header[1] != 'M')
 		return (error(HEADER_E2));
 	bmp_size = deserialize(bmp_header, 2, 4);
-	std::cerr << "bmp_size: " << bmp_size << std::endl;
 	data_offset = deserialize(bmp_header, 10, 4);
-	std::cerr << "data_offset: " << data_offset << std::endl;
+	dib_size = deserialize(dib_header, 0, 4);
+	if (dib_size < DIB_HSIZE || dib_size > map_size - BMP_HSIZE)
+		return (error(HEADER_E2));
 	width = deserialize(dib_header, 4, 4);
-	std::cerr << "width: " << width << std::endl;
-	height = deserialize(dib_header, 8, 4);
-	std::cerr << "height: " << height << std::endl;
+	h = deserialize(dib_header, 8, 4);
+	top_down = h < 0;
+	height = top_down ? 0U - (uint32_t)h : (uint32_t)h;
+	if (width > BMP_MAX_SIZE || height > BMP_MAX_SIZE)
+		return (error(HEADER_E2));
 	bpp = deserialize(dib_header, 14, 2);
-	std::cerr << "bpp: " << bpp << std::endl;
 	compression = deserialize(dib_header, 16, 4);
-	if (!compressionSupported())
+	if (compression >= CMP_MAX || !compressionSupported())
 		return (error(COMPRESSION_E1));
+	if (!bppSupported(compression, bpp))
+		return (error(BPP_E1));
+	if (top_down && sequential())
+		return (error(HEADER_E2));
 	raw_bmp_size = deserialize(dib_header, 20, 4);
-	std::cerr << "raw_bmp_size: " << raw_bmp_size << std::endl;
-	unused_header_size = data_offset - (BMP_HSIZE + DIB_HSIZE);
 	if (!raw_bmp_size)
 		raw_bmp_size = bmp_size - (BMP_HSIZE + DIB_HSIZE);
-	std::cerr << "unused header size: " << unused_header_size << std::endl;
-	if (unused_header_size > 0)
+	if (!readMasks() || !readPalette())
+		return (0);
+	if (data_offset > map_size)
+		return (error(DATA_E1));
+	row_size = ((uint64_t)width * bpp + 31) / 32 * 4;
+	if (!sequential() && row_size * height > map_size - data_offset)
+		return (error(DATA_E1));
+	if (sequential()
+		&& (uint64_t)width * height > (uint64_t)(map_size - data_offset) * BMP_RLE_RATIO)
+		return (error(DATA_E1));
+	return (1);
+}
+
+/*
+** Masks follow a 40 byte header, or are part of a V4/V5 header at the same
+** offset. A fourth word after a 40 byte header is taken as the alpha mask
+** when the pixels start after it, as some writers do. BI_RGB has fixed
+** masks: X1R5G5B5 for 16 bpp, X8R8G8B8 for 32 bpp.
+*/
+int
+Bmp::readMasks(void)
+{
+	uint32_t const		dib_size = deserialize(dib_header, 0, 4);
+	uint32_t			count;
+	uint32_t			bits;
+	uint32_t			v;
+	int					c;
+
+	std::memset(masks, 0, sizeof(masks));
+	byte_aligned = false;
+	if (bpp != 16 && bpp != 32)
+		return (1);
+	if (compression == BI_RGB)
+	{
+		masks[0] = bpp == 16 ? 0x7C00 : 0x00FF0000;
+		masks[1] = bpp == 16 ? 0x03E0 : 0x0000FF00;
+		masks[2] = bpp == 16 ? 0x001F : 0x000000FF;
+	}
+	else
 	{
-		unused_header = new unsigned char[unused_header_size];
-		(void)!read(fd, unused_header, unused_header_size);
-		delete [] unused_header;
+		count = compression == BI_ALPHABITFIELDS || dib_size >= 56
+				|| data_offset >= BMP_HSIZE + DIB_HSIZE + 16 ? 4 : 3;
+		if (BMP_HSIZE + DIB_HSIZE + count * 4 > map_size)
+			return (error(MASK_E1));
+		c = 0;
+		while (c < (int)count)
+		{
+			masks[c] = deserialize(map, BMP_HSIZE + DIB_HSIZE + c * 4, 4);
+			++c;
+		}
+	}
+	byte_aligned = bpp == 32;
+	c = 0;
+	while (c < 4)
+	{
+		channels[c].shift = 0;
+		channels[c].mask = 0;
+		channels[c].scale[0] = 0xFF;
+		order[c] = 0;
+		if (masks[c] == 0)
+		{
+			if (c < 3)
+				return (error(MASK_E1));
+			++c;
+			continue ;
+		}
+		if (bpp == 16 && masks[c] > 0xFFFF)
+			return (error(MASK_E1));
+		while (!((masks[c] >> channels[c].shift) & 1))
+			channels[c].shift++;
+		v = masks[c] >> channels[c].shift;
+		if (v & (v + 1))
+			return (error(MASK_E1));
+		bits = 0;
+		while (bits < 32 && (v >> bits) != 0)
+			bits++;
+		if (bits > 8)
+			channels[c].shift += bits - 8;
+		channels[c].mask = bits > 8 ? 0xFF : (1U << bits) - 1;
+		v = 0;
+		while (v <= channels[c].mask)
+		{
+			channels[c].scale[v] = (v * 255 + channels[c].mask / 2) / channels[c].mask;
+			++v;
+		}
+		if (bits != 8 || channels[c].shift % 8 != 0)
+			byte_aligned = false;
+		order[c] = channels[c].shift / 8;
+		++c;
 	}
 	return (1);
 }
 
+/*
+** Palette entries are BGRX, kept here as RGBA words so an indexed pixel
+** is a single 4 byte copy. Missing entries are opaque black.
+*/
 int
-Bmp::writeData(void)
+Bmp::readPalette(void)
 {
-	unsigned char		buf[4];
+	uint32_t const		dib_size = deserialize(dib_header, 0, 4);
+	unsigned char const	*p;
+	unsigned char		rgba[4];
 	uint32_t			i;
-	uint32_t			j;
-	uint32_t			k;
+
+	colors = 0;
+	if (bpp > 8)
+		return (1);
+	colors = deserialize(dib_header, 32, 4);
+	if (colors == 0 || colors > (1U << bpp))
+		colors = 1U << bpp;
+	if ((uint64_t)BMP_HSIZE + dib_size + colors * 4 > map_size)
+		return (error(PALETTE_E1));
+	p = map + BMP_HSIZE + dib_size;
+	i = 0;
+	while (i < 256)
+	{
+		rgba[0] = i < colors ? p[i * 4 + 2] : 0;
+		rgba[1] = i < colors ? p[i * 4 + 1] : 0;
+		rgba[2] = i < colors ? p[i * 4] : 0;
+		rgba[3] = 0xFF;
+		std::memcpy(&palette[i], rgba, 4);
+		++i;
+	}
+	return (1);
+}
+
+bool
+Bmp::sequential(void) const
+{
+	return (compression == BI_RLE8 || compression == BI_RLE4);
+}
+
+void
+Bmp::decodeIndexed(unsigned char const *row, unsigned char *out) const
+{
+	uint32_t const		index_mask = (1U << bpp) - 1;
+	uint32_t			x;
+	uint32_t			bit;
+
+	x = 0;
+	while (x < width)
+	{
+		bit = x * bpp;
+		std::memcpy(out + x * 4, &palette[(row[bit >> 3] >> (8 - bpp - (bit & 7))) & index_mask], 4);
+		++x;
+	}
+}
+
+void
+Bmp::decodeMasked(unsigned char const *row, unsigned char *out) const
+{
+	uint32_t			v;
+	uint32_t			x;
+	int					c;
+
+	x = 0;
+	while (x < width)
+	{
+		if (bpp == 16)
+			v = row[x * 2] | (row[x * 2 + 1] << 8);
+		else
+			v = deserialize(row, x * 4, 4);
+		c = 0;
+		while (c < 4)
+		{
+			out[x * 4 + c] = channels[c].scale[(v >> channels[c].shift) & channels[c].mask];
+			++c;
+		}
+		++x;
+	}
+}
+
+/*
+** 24 bpp rows are BGR and get an opaque alpha. 32 bpp rows with whole byte
+** channels are a shuffle, other masks go through the channel tables.
+*/
+void
+Bmp::decodeRow(unsigned char const *row, unsigned char *out) const
+{
+	static unsigned char const	bgr_order[3] = { 2, 1, 0 };
+	uint32_t					x;
 
 	if (bpp == 24)
+		swizzle24to32(out, row, width, bgr_order, 0xFF);
+	else if (byte_aligned)
 	{
-		k = 0;
-		i = 0;
-		while (i < height)
+		swizzle32to32(out, row, width, order);
+		if (masks[3] == 0)
 		{
-			j = 0;
-			while (j < width)
-			{
-				if (read(fd, buf, 3) == -1)
-					return (0);
-				data[k++] = buf[2];
-				data[k++] = buf[1];
-				data[k++] = buf[0];
-				j++;
-			}
-			if (j % 4)
-				if (read(fd, buf, 1) == -1)
-					return (0);
-			i++;
+			x = 0;
+			while (x < width)
+				out[x++ * 4 + 3] = 0xFF;
 		}
 	}
-	else if (bpp == 32)
+	else if (bpp > 8)
+		decodeMasked(row, out);
+	else
+		decodeIndexed(row, out);
+}
+
+/*
+** RLE8 and RLE4, bottom-up only. Pairs are either a run (count, color) or
+** an escape (0, code): end of line, end of bitmap, delta (dx, dy), or an
+** absolute run of code indices padded to 16 bits. Skipped pixels are
+** transparent black; anything past the image or the file is dropped.
+** Decodes rows [first, first + count) into out and stops at the first
+** pair below first + count, so the next band resumes from rle.
+*/
+void
+Bmp::decodeRle(Rle &rle, uint32_t const &first, uint32_t const &count, unsigned char *out) const
+{
+	unsigned char const	*end = map + map_size;
+	unsigned char const	*p = rle.p;
+	size_t				bytes;
+	uint32_t			n;
+	uint32_t			i;
+	unsigned char		c;
+
+	std::memset(out, 0, (size_t)width * count * 4);
+	while (end - p >= 2 && rle.y < first + count)
 	{
-		k = 0;
-		i = 0;
-		while (i < height)
+		n = p[0];
+		c = p[1];
+		p += 2;
+		if (n > 0)
+		{
+			i = 0;
+			while (i < n && rle.x < width)
+			{
+				std::memcpy(out + ((size_t)(rle.y - first) * width + rle.x) * 4,
+							&palette[bpp == 8 ? c : (i & 1 ? c & 15 : c >> 4)], 4);
+				++rle.x;
+				++i;
+			}
+		}
+		else if (c == 0)
+		{
+			rle.x = 0;
+			++rle.y;
+		}
+		else if (c == 1)
+		{
+			rle.y = height;
+			break ;
+		}
+		else if (c == 2)
 		{
-			j = 0;
-			while (j < width)
+			if (end - p < 2)
 			{
-				if (read(fd, buf, 4) == -1)
-					return (0);
-				// std::cerr << "Pixel R:" << int(buf[1]) << ", G:" << int(buf[2]) << ", B:" << int(buf[3]) << ", A:" << int(buf[0]) << std::endl;
-				data[k++] = buf[1];
-				data[k++] = buf[2];
-				data[k++] = buf[3];
-				data[k++] = buf[0];
-				j++;
+				p = end;
+				break ;
 			}
-			i++;
+			rle.x += p[0];
+			rle.y += p[1];
+			p += 2;
 		}
+		else
+		{
+			bytes = bpp == 8 ? c : (c + 1) / 2;
+			if ((size_t)(end - p) < bytes)
+			{
+				p = end;
+				break ;
+			}
+			i = 0;
+			while (i < c && rle.x < width)
+			{
+				std::memcpy(out + ((size_t)(rle.y - first) * width + rle.x) * 4,
+							&palette[bpp == 8 ? p[i] : (i & 1 ? p[i >> 1] & 15 : p[i >> 1] >> 4)], 4);
+				++rle.x;
+				++i;
+			}
+			bytes = (bytes + 1) & ~(size_t)1;
+			p += (size_t)(end - p) < bytes ? end - p : bytes;
+		}
+	}
+	if (end - p < 2)
+		rle.y = height;
+	rle.p = p;
+}
+
+/*
+** Converts count rows, starting at row first (bottom row 0), to RGBA in
+** out, each row of the file being padded to 4 bytes.
+*/
+void
+Bmp::decodeRows(uint32_t const &first, uint32_t const &count, unsigned char *out) const
+{
+	size_t const				row_size = ((size_t)width * bpp + 31) / 32 * 4;
+	uint32_t					y;
+
+	y = 0;
+	while (y < count)
+	{
+		decodeRow(map + data_offset + row_size * (top_down ? height - 1 - first - y : first + y),
+				out + (size_t)width * 4 * y);
+		y++;
 	}
+}
+
+int
+Bmp::writeData(uint32_t const &first, uint32_t const &count)
+{
+	Rle							rle;
+
+	if (map == 0 || first > height || count > height - first)
+		return (error(DATA_E1));
+	if (sequential())
+	{
+		if (first != 0 || count != height)
+			return (error(RLE_E1));
+		rle.p = map + data_offset;
+		rle.x = 0;
+		rle.y = 0;
+		decodeRle(rle, 0, height, data);
+		return (1);
+	}
+	decodeRows(first, count, data + (size_t)width * 4 * first);
 	return (1);
 }
 
+/*
+** Decodes the image band by band without allocating data: each band of
+** band_rows rows (bottom row first, the last one shorter) is converted
+** into a single band buffer and handed to callback, which may return 0
+** to stop. Peak memory is one band plus the file pages of one band.
+*/
+int
+Bmp::stream(char const *filename, uint32_t const &band_rows, BandCallback const &callback)
+{
+	size_t				row_size;
+	unsigned char		*band;
+	unsigned char const	*start;
+	uint32_t			first;
+	uint32_t			count;
+	Rle					rle;
+	int					ret;
+
+	if (!mapFile(filename))
+		return (0);
+	if (band_rows == 0)
+		return (closeFile(), error(DATA_E1));
+	row_size = ((size_t)width * bpp + 31) / 32 * 4;
+	band = new unsigned char[(size_t)width * (band_rows < height ? band_rows : height) * 4];
+	rle.p = map + data_offset;
+	rle.x = 0;
+	rle.y = 0;
+	ret = 1;
+	first = 0;
+	while (ret && first < height)
+	{
+		count = height - first < band_rows ? height - first : band_rows;
+		start = rle.p;
+		if (sequential())
+			decodeRle(rle, first, count, band);
+		else
+			decodeRows(first, count, band);
+		ret = callback(first, count, band);
+		if (sequential())
+			file.release(start - map, rle.p - map);
+		else if (top_down)
+			file.release(data_offset + row_size * (height - first - count),
+						data_offset + row_size * (height - first));
+		else
+			file.release(data_offset + row_size * first,
+						data_offset + row_size * (first + count));
+		first += count;
+	}
+	delete [] band;
+	closeFile();
+	return (ret);
+}
+
+/*
+** The file is mapped once, headers are validated in place and the pixels
+** converted straight from the mapping, no read() per pixel.
+*/
 int
 Bmp::load(char const *filename)
 {
-	// std::cerr << "Loading " << filename << std::endl;
-	if ((fd = open(filename, O_RDONLY)) == -1)
-		return (error(FILE_E1));
-	if (read(fd, bmp_header, BMP_HSIZE) == -1)
-		return (error(HEADER_E1));
-	if (read(fd, dib_header, DIB_HSIZE) == -1)
-		return (error(HEADER_E3));
-	if (!getBmpInfo())
+	int					ret;
+
+	if (!openFile(filename))
 		return (0);
-	data = new unsigned char[raw_bmp_size];
-	if (!writeData())
+	ret = writeData(0, height);
+	closeFile();
+	return (ret);
+}
+
+int
+Bmp::openFile(char const *filename)
+{
+	if (!mapFile(filename))
+		return (0);
+	delete [] data;
+	data = new unsigned char[(size_t)width * height * 4];
+	return (1);
+}
+
+int
+Bmp::openBuffer(unsigned char *bytes, size_t const &size)
+{
+	closeFile();
+	file.adopt(bytes, size);
+	if (!readHeaders())
 		return (0);
-	close(fd);
+	delete [] data;
+	data = new unsigned char[(size_t)width * height * 4];
 	return (1);
 }
 
+int
+Bmp::mapFile(char const *filename)
+{
+	closeFile();
+	if (!file.open(filename, MAPPED_SEQUENTIAL))
+		return (error(FILE_E1));
+	return (readHeaders());
+}
+
+int
+Bmp::readHeaders(void)
+{
+	if (file.size() < BMP_HSIZE + DIB_HSIZE)
+		return (closeFile(), error(HEADER_E1));
+	map = file.data();
+	map_size = file.size();
+	std::memcpy(bmp_header, map, BMP_HSIZE);
+	std::memcpy(dib_header, map + BMP_HSIZE, DIB_HSIZE);
+	if (!getBmpInfo())
+		return (closeFile(), 0);
+	return (1);
+}
+
+void
+Bmp::closeFile(void)
+{
+	file.close();
+	map = 0;
+	map_size = 0;
+}
+
 Bmp &
 Bmp::operator=(Bmp const &rhs)
 {
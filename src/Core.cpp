@@ -1,7 +1,8 @@
 
 #include "Core.hpp"
 
-Core::Core(void)
+Core::Core(void) : shaders(programCache), assetIO(pool), textures(pool, assetIO, streamer),
+	textureCache(pool, textures, streamer), virtualTexture(pool, assetIO)
 {
 }
 
@@ -62,13 +63,7 @@ Core::buildProjectionMatrix(Mat4<float> &proj, float const &fov,
 	float const			f = 1.0f / tan(fov * (M_PI / 360.0));
 	float const			ratio = (1.0f * windowWidth) / windowHeight;
 
-	proj.setIdentity();
-	proj[0] = f / ratio;
-	proj[1 * 4 + 1] = f;
-	proj[2 * 4 + 2] = (far + near) / (near - far);
-	proj[3 * 4 + 2] = (2.0f * far * near) / (near - far);
-	proj[2 * 4 + 3] = -1.0f;
-	proj[3 * 4 + 3] = 0.0f;
+	proj = Mat4<float>::perspective(f, ratio, near, far);
 }
 
 void
@@ -109,7 +104,6 @@ Core::setCamera(Mat4<float> &view, Vec3<float> const &pos, Vec3<float> const &lo
 	Vec3<float>		dir;
 	Vec3<float>		right;
 	Vec3<float>		up;
-	Mat4<float>		translation;
 
 	up.set(0.0f, 1.0f, 0.0f);
 	dir.set(lookAt - pos);
@@ -119,8 +113,7 @@ Core::setCamera(Mat4<float> &view, Vec3<float> const &pos, Vec3<float> const &lo
 	up.crossProduct(right, dir);
 	up.normalize();
 	setViewMatrix(view, dir, right, up);
-	translation.setTranslation(-pos.x, -pos.y, -pos.z);
-	view.multiply(translation);
+	view.multiply(Mat4<float>::translation(-pos.x, -pos.y, -pos.z));
 }
 
 void
@@ -135,23 +128,33 @@ Core::getLocations(void)
 	objLoc = glGetUniformLocation(this->program, "obj_matrix");
 }
 
+/*
+** Returns immediately, the image is decoded on the pool and streamed by
+** loop(). Call textures.finish() to wait for everything requested so far.
+** A file already loaded, under this path or another one, is shared: each
+** loadTexture() must be paired with a releaseTexture().
+*/
 GLuint
 Core::loadTexture(char const *filename)
 {
-	GLuint				texture;
-	Bmp					bmp;
+	return (textureCache.acquire(filename));
+}
 
-	if (!bmp.load(filename))
-		return (printError("Failed to load bmp !", 0));
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, bmp.width, bmp.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, bmp.data);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	checkGlError(__FILE__, __LINE__);
-	return (texture);
+void
+Core::releaseTexture(GLuint const &texture)
+{
+	textureCache.release(texture);
+}
+
+/*
+** An image too large to load whole, paged in as it is seen (see
+** VirtualTexture). Its page file is cooked on the pool the first time, and
+** loop() starts reading pages once it is there.
+*/
+int
+Core::loadVirtualTexture(char const *filename)
+{
+	return (virtualTexture.init(filename, windowWidth, windowHeight));
 }
 
 void
@@ -207,9 +210,14 @@ Core::init(void)
 	// cameraPos.set(5.5f, 5.5f, 5.5f);
 	cameraLookAt.set(0.0f, 0.0f, 0.0f);
 	setCamera(viewMatrix, cameraPos, cameraLookAt);
+	if (access(PACK_DEFAULT, R_OK) == 0 && !Pack::mount(PACK_DEFAULT))
+		return (0);
 	if (!initShaders())
 		return (0);
 	getLocations();
+	if (!streamer.init())
+		return (0);
+	assetIO.init();
 #ifndef __APPLE__
 	if (glDebugMessageControlARB != NULL)
 	{
@@ -223,103 +231,20 @@ Core::init(void)
 	return (1);
 }
 
-int
-Core::compileShader(GLuint shader, char const *filename)
-{
-	GLint			logsize;
-	GLint			state;
-	char			*compileLog;
-
-	glCompileShader(shader);
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &state);
-	if (state != GL_TRUE)
-	{
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logsize);
-		compileLog = new char[logsize + 1];
-		std::memset(compileLog, '\0', logsize + 1);
-		glGetShaderInfoLog(shader, logsize, &logsize, compileLog);
-		std::cerr	<< "Failed to compile shader `"
-					<< filename
-					<< "`: " << std::endl
-					<< compileLog;
-		delete compileLog;
-		return (0);
-	}
-	return (1);
-}
-
-GLuint
-Core::loadShader(GLenum type, char const *filename)
-{
-	GLuint			shader;
-	char			*source;
-
-	shader = glCreateShader(type);
-	if (shader == 0)
-		return (printError("Failed to create shader !", 0));
-	if (!(source = readFile(filename)))
-		return (printError("Failed to read file !", 0));
-	glShaderSource(shader, 1, (char const **)&source, 0);
-	if (!compileShader(shader, filename))
-		return (0);
-	delete source;
-	return (shader);
-}
-
-int
-Core::loadShaders(void)
-{
-	if (!(vertexShader = loadShader(GL_VERTEX_SHADER, "./shaders/vertex_shader.gls")))
-		return (printError("Failed to load vertex shader !", 0));
-	if (!(fragmentShader = loadShader(GL_FRAGMENT_SHADER, "./shaders/fragment_shader.gls")))
-		return (printError("Failed to load fragment shader !", 0));
-	return (1);
-}
-
-int
-Core::linkProgram(GLuint &program)
-{
-	GLint			logSize;
-	GLint			state;
-	char			*linkLog;
-
-	glLinkProgram(program);
-	glGetProgramiv(program, GL_LINK_STATUS, &state);
-	if (state != GL_TRUE)
-	{
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logSize);
-		linkLog = new char[logSize + 1];
-		std::memset(linkLog, '\0', logSize + 1);
-		glGetProgramInfoLog(program, logSize, &logSize, linkLog);
-		std::cerr	<< "Failed to link program !" << std::endl
-					<< linkLog;
-		delete [] linkLog;
-		return (0);
-	}
-	return (1);
-}
-
-void
-Core::deleteShaders(void)
-{
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-}
-
+/*
+** The default program is the variant without features, built now: from
+** its binary when the sources and the driver are the ones it was stored
+** with, compiled and stored otherwise.
+*/
 int
 Core::initShaders(void)
 {
-	if (!loadShaders())
-		return (0);
-	if (!(program = glCreateProgram()))
-		return (printError("Failed to create program !", 0));
-	glAttachShader(program, vertexShader);
-	glAttachShader(program, fragmentShader);
-	glBindFragDataLocation(program, 0, "out_fragment");
-	if (!linkProgram(program))
+	programCache.init();
+	if (!shaders.init("default", VERTEX_SHADER, FRAGMENT_SHADER))
 		return (0);
+	if (!(program = shaders.wait(0)))
+		return (printError("Failed to build program !", 0));
 	checkGlError(__FILE__, __LINE__);
-	deleteShaders();
 	return (1);
 }
 
@@ -391,6 +316,11 @@ Core::loop(void)
 		currentTime = glfwGetTime();
 		frames += 1.0;
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		textures.upload(TEXTURE_UPLOADS_PER_FRAME);
+		textureCache.update();
+		streamer.update();
+		virtualTexture.update();
+		shaders.update();
 		update();
 		render();
 		glfwSwapBuffers(window);
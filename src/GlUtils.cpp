@@ -0,0 +1,18 @@
+#include "Utils.hpp"
+
+bool
+hasGlExtension(char const *extension)
+{
+	GLint		count;
+	GLint		i;
+
+	count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	i = 0;
+	while (i < count)
+	{
+		if (std::strcmp((char const *)glGetStringi(GL_EXTENSIONS, i++), extension) == 0)
+			return (true);
+	}
+	return (false);
+}
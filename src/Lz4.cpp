@@ -0,0 +1,184 @@
+
+#include <cstring>
+#include <stdint.h>
+#include "Lz4.hpp"
+
+#define LZ4_HASH_LOG		(12)
+#define LZ4_MIN_MATCH		(4)
+/* the last match must start this far from the end... */
+#define LZ4_MF_LIMIT		(12)
+/* ...and the block must end with this many literals */
+#define LZ4_LAST_LITERALS	(5)
+#define LZ4_MAX_OFFSET		(65535)
+
+static inline uint32_t
+read32(unsigned char const *p)
+{
+	uint32_t		v;
+
+	std::memcpy(&v, p, sizeof(v));
+	return (v);
+}
+
+static inline uint32_t
+hash32(uint32_t const &v)
+{
+	return ((v * 2654435761U) >> (32 - LZ4_HASH_LOG));
+}
+
+/* writes the 255, 255, ..., rest tail of a length that did not fit in 4 bits */
+static inline unsigned char *
+writeLength(unsigned char *op, size_t len)
+{
+	while (len >= 255)
+	{
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char)len;
+	return (op);
+}
+
+static inline unsigned char *
+writeSequence(unsigned char *op, unsigned char const *literals, size_t const &litLen,
+				size_t const &offset, size_t const &matchLen)
+{
+	unsigned char	*token;
+
+	token = op++;
+	*token = (unsigned char)((litLen < 15 ? litLen : 15) << 4);
+	if (litLen >= 15)
+		op = writeLength(op, litLen - 15);
+	if (litLen > 0)
+		std::memcpy(op, literals, litLen);
+	op += litLen;
+	if (matchLen == 0)
+		return (op);
+	*op++ = (unsigned char)(offset & 0xFF);
+	*op++ = (unsigned char)(offset >> 8);
+	*token |= (unsigned char)(matchLen - LZ4_MIN_MATCH < 15 ? matchLen - LZ4_MIN_MATCH : 15);
+	if (matchLen - LZ4_MIN_MATCH >= 15)
+		op = writeLength(op, matchLen - LZ4_MIN_MATCH - 15);
+	return (op);
+}
+
+size_t
+lz4Bound(size_t const &n)
+{
+	return (n + n / 255 + 16);
+}
+
+/*
+** Greedy: hash the 4 bytes at ip, take the previous position with the same
+** hash as a candidate, extend the match forward. The step grows on long
+** runs without a match so incompressible data is skipped quickly.
+*/
+size_t
+lz4Compress(unsigned char const *src, size_t const &size,
+			unsigned char *dst, size_t const &capacity)
+{
+	uint32_t		table[1 << LZ4_HASH_LOG];
+	size_t			ip;
+	size_t			anchor;
+	size_t			cand;
+	size_t			len;
+	uint32_t		h;
+	unsigned char	*op;
+
+	if (capacity < lz4Bound(size))
+		return (0);
+	std::memset(table, 0, sizeof(table));
+	op = dst;
+	ip = 0;
+	anchor = 0;
+	while (size > LZ4_MF_LIMIT && ip < size - LZ4_MF_LIMIT)
+	{
+		h = hash32(read32(src + ip));
+		cand = table[h];
+		table[h] = (uint32_t)ip;
+		if (cand < ip && ip - cand <= LZ4_MAX_OFFSET && read32(src + cand) == read32(src + ip))
+		{
+			len = LZ4_MIN_MATCH;
+			while (ip + len < size - LZ4_LAST_LITERALS && src[cand + len] == src[ip + len])
+				++len;
+			op = writeSequence(op, src + anchor, ip - anchor, ip - cand, len);
+			ip += len;
+			anchor = ip;
+		}
+		else
+			ip += 1 + ((ip - anchor) >> 6);
+	}
+	op = writeSequence(op, src + anchor, size - anchor, 0, 0);
+	return (op - dst);
+}
+
+static inline int
+readLength(unsigned char const *&ip, unsigned char const *end, size_t &len)
+{
+	unsigned char	b;
+
+	do
+	{
+		if (ip >= end)
+			return (0);
+		b = *ip++;
+		len += b;
+	}
+	while (b == 255);
+	return (1);
+}
+
+int
+lz4Decompress(unsigned char const *src, size_t const &srcSize,
+			unsigned char *dst, size_t const &dstSize)
+{
+	unsigned char const		*ip = src;
+	unsigned char const		*end = src + srcSize;
+	unsigned char			*op = dst;
+	unsigned char			*dstEnd = dst + dstSize;
+	unsigned char			token;
+	size_t					len;
+	size_t					offset;
+
+	while (ip < end)
+	{
+		token = *ip++;
+		len = token >> 4;
+		if (len == 15 && !readLength(ip, end, len))
+			return (0);
+		if (len > (size_t)(end - ip) || len > (size_t)(dstEnd - op))
+			return (0);
+		if (len > 0)
+			std::memcpy(op, ip, len);
+		ip += len;
+		op += len;
+		if (ip == end)
+			break ;
+		if (end - ip < 2)
+			return (0);
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return (0);
+		len = token & 15;
+		if (len == 15 && !readLength(ip, end, len))
+			return (0);
+		len += LZ4_MIN_MATCH;
+		if (len > (size_t)(dstEnd - op))
+			return (0);
+		if (offset >= len)
+			std::memcpy(op, op - offset, len);
+		else
+		{
+			/* overlapping copy repeats the last offset bytes */
+			while (len--)
+			{
+				*op = *(op - offset);
+				++op;
+			}
+			continue ;
+		}
+		op += len;
+	}
+	return (op == dstEnd);
+}
@@ -0,0 +1,182 @@
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "MappedFile.hpp"
+#include "Pack.hpp"
+#include "Lz4.hpp"
+
+MappedFile::MappedFile(void) : bytes(0), length(0), storage(READ)
+{
+	return ;
+}
+
+MappedFile::~MappedFile(void)
+{
+	close();
+	return ;
+}
+
+int
+MappedFile::open(char const *filename, int const &hints)
+{
+	struct stat		st;
+	void			*addr;
+	int				fd;
+	int				ret;
+
+	close();
+	if (!(hints & MAPPED_NO_PACK) && (ret = openPacked(filename, hints)) != -1)
+		return (ret);
+	if ((fd = ::open(filename, O_RDONLY)) == -1)
+		return (0);
+	if (fstat(fd, &st) == -1)
+		return (::close(fd), 0);
+	addr = MAP_FAILED;
+	if (S_ISREG(st.st_mode) && st.st_size > 0)
+		addr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED)
+	{
+		ret = read(fd);
+		::close(fd);
+		return (ret);
+	}
+	::close(fd);
+	bytes = (unsigned char *)addr;
+	length = st.st_size;
+	storage = MAPPED;
+	if (hints & MAPPED_SEQUENTIAL)
+		advise(0, length, MADV_SEQUENTIAL);
+	if (hints & MAPPED_WILLNEED)
+		advise(0, length, MADV_WILLNEED);
+	return (1);
+}
+
+/*
+** -1 if no mounted pack has the file. A stored entry is a view into the
+** pack mapping, a compressed one is decompressed whole.
+*/
+int
+MappedFile::openPacked(char const *filename, int const &hints)
+{
+	Pack const		*pack;
+	PackEntry const	*entry;
+
+	if ((entry = Pack::resolve(filename, pack)) == 0)
+		return (-1);
+	length = entry->rawSize;
+	if (!(entry->flags & PACK_LZ4))
+	{
+		bytes = const_cast<unsigned char *>(pack->data(entry));
+		storage = PACKED;
+		if (hints & MAPPED_SEQUENTIAL)
+			advise(0, length, MADV_SEQUENTIAL);
+		if (hints & MAPPED_WILLNEED)
+			advise(0, length, MADV_WILLNEED);
+		return (1);
+	}
+	bytes = new unsigned char[length];
+	if (!lz4Decompress(pack->data(entry), entry->size, bytes, length))
+		return (close(), 0);
+	return (1);
+}
+
+/*
+** Reads up to the end of the file rather than st_size bytes, pipes and
+** /proc files report 0. read() rather than pread(), which fails on pipes;
+** the descriptor was just opened so both start at 0.
+*/
+int
+MappedFile::read(int const &fd)
+{
+	unsigned char	*grown;
+	size_t			capacity;
+	ssize_t			n;
+
+	capacity = MAPPED_READ_CHUNK;
+	bytes = new unsigned char[capacity];
+	while ((n = ::read(fd, bytes + length, capacity - length)) != 0)
+	{
+		if (n == -1)
+			return (close(), 0);
+		length += n;
+		if (length < capacity)
+			continue ;
+		grown = new unsigned char[capacity * 2];
+		std::memcpy(grown, bytes, length);
+		delete [] bytes;
+		bytes = grown;
+		capacity *= 2;
+	}
+	return (1);
+}
+
+void
+MappedFile::adopt(unsigned char *buffer, size_t const &size)
+{
+	close();
+	bytes = buffer;
+	length = size;
+}
+
+void
+MappedFile::close(void)
+{
+	if (storage == MAPPED)
+		munmap(bytes, length);
+	else if (storage == READ)
+		delete [] bytes;
+	bytes = 0;
+	length = 0;
+	storage = READ;
+}
+
+/*
+** A packed file does not start on a page, so pages are aligned on their
+** address: the ones shared with a neighbour entry are only hinted, never
+** dropped.
+*/
+void
+MappedFile::advise(size_t const &from, size_t const &to, int const &advice)
+{
+	uintptr_t const	page = sysconf(_SC_PAGESIZE);
+	uintptr_t		lo;
+	uintptr_t		hi;
+
+	if (storage == READ)
+		return ;
+	lo = (uintptr_t)bytes + from;
+	hi = (uintptr_t)bytes + (to < length ? to : length);
+	if (advice == MADV_DONTNEED)
+	{
+		lo = (lo + page - 1) / page * page;
+		hi = hi / page * page;
+	}
+	else
+	{
+		lo = lo / page * page;
+		hi = (hi + page - 1) / page * page;
+	}
+	if (lo < hi)
+		madvise((void *)lo, hi - lo, advice);
+}
+
+void
+MappedFile::release(size_t const &from, size_t const &to)
+{
+	advise(from, to, MADV_DONTNEED);
+}
+
+unsigned char const *
+MappedFile::data(void) const
+{
+	return (bytes);
+}
+
+size_t
+MappedFile::size(void) const
+{
+	return (length);
+}
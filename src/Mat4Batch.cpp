@@ -0,0 +1,116 @@
+#include "Mat4Batch.hpp"
+
+/*
+** The vector loops return where they stopped, the scalar template kernels
+** finish the range.
+*/
+
+#if defined(SIMD_DISPATCH)
+
+SIMD_TARGET("avx,fma") static size_t
+transformPointsAvx(float const *m, float const *x, float const *y, float const *z,
+					float *ox, float *oy, float *oz, size_t i, size_t const &end)
+{
+	__m256 const	m0 = _mm256_set1_ps(m[0]);
+	__m256 const	m1 = _mm256_set1_ps(m[1]);
+	__m256 const	m2 = _mm256_set1_ps(m[2]);
+	__m256 const	m4 = _mm256_set1_ps(m[4]);
+	__m256 const	m5 = _mm256_set1_ps(m[5]);
+	__m256 const	m6 = _mm256_set1_ps(m[6]);
+	__m256 const	m8 = _mm256_set1_ps(m[8]);
+	__m256 const	m9 = _mm256_set1_ps(m[9]);
+	__m256 const	m10 = _mm256_set1_ps(m[10]);
+	__m256 const	m12 = _mm256_set1_ps(m[12]);
+	__m256 const	m13 = _mm256_set1_ps(m[13]);
+	__m256 const	m14 = _mm256_set1_ps(m[14]);
+	__m256			px;
+	__m256			py;
+	__m256			pz;
+
+	while (i + 8 <= end)
+	{
+		px = _mm256_loadu_ps(x + i);
+		py = _mm256_loadu_ps(y + i);
+		pz = _mm256_loadu_ps(z + i);
+		_mm256_storeu_ps(ox + i, _mm256_fmadd_ps(m0, px, _mm256_fmadd_ps(m4, py, _mm256_fmadd_ps(m8, pz, m12))));
+		_mm256_storeu_ps(oy + i, _mm256_fmadd_ps(m1, px, _mm256_fmadd_ps(m5, py, _mm256_fmadd_ps(m9, pz, m13))));
+		_mm256_storeu_ps(oz + i, _mm256_fmadd_ps(m2, px, _mm256_fmadd_ps(m6, py, _mm256_fmadd_ps(m10, pz, m14))));
+		i += 8;
+	}
+	return (i);
+}
+
+static size_t
+transformPointsSse2(float const *m, float const *x, float const *y, float const *z,
+					float *ox, float *oy, float *oz, size_t i, size_t const &end)
+{
+	__m128 const	m0 = _mm_set1_ps(m[0]);
+	__m128 const	m1 = _mm_set1_ps(m[1]);
+	__m128 const	m2 = _mm_set1_ps(m[2]);
+	__m128 const	m4 = _mm_set1_ps(m[4]);
+	__m128 const	m5 = _mm_set1_ps(m[5]);
+	__m128 const	m6 = _mm_set1_ps(m[6]);
+	__m128 const	m8 = _mm_set1_ps(m[8]);
+	__m128 const	m9 = _mm_set1_ps(m[9]);
+	__m128 const	m10 = _mm_set1_ps(m[10]);
+	__m128 const	m12 = _mm_set1_ps(m[12]);
+	__m128 const	m13 = _mm_set1_ps(m[13]);
+	__m128 const	m14 = _mm_set1_ps(m[14]);
+	__m128			px;
+	__m128			py;
+	__m128			pz;
+
+	while (i + 4 <= end)
+	{
+		px = _mm_loadu_ps(x + i);
+		py = _mm_loadu_ps(y + i);
+		pz = _mm_loadu_ps(z + i);
+		_mm_storeu_ps(ox + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)),
+										_mm_add_ps(_mm_mul_ps(m8, pz), m12)));
+		_mm_storeu_ps(oy + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)),
+										_mm_add_ps(_mm_mul_ps(m9, pz), m13)));
+		_mm_storeu_ps(oz + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)),
+										_mm_add_ps(_mm_mul_ps(m10, pz), m14)));
+		i += 4;
+	}
+	return (i);
+}
+
+SIMD_TARGET("avx,fma") static void
+multiplyMatricesAvx(Mat4<float> const &parent, Mat4<float> const *local,
+					Mat4<float> *out, size_t i, size_t const &end)
+{
+	while (i < end)
+	{
+		mat4MultiplyAvx(out[i].val, parent.val, local[i].val);
+		++i;
+	}
+}
+
+#endif
+
+void
+transformPointsRange(float const *m, float const *x, float const *y, float const *z,
+					float *ox, float *oy, float *oz, size_t i, size_t const &end)
+{
+#if defined(SIMD_DISPATCH)
+	if (simdLevel() >= SIMD_LEVEL_AVX2)
+		i = transformPointsAvx(m, x, y, z, ox, oy, oz, i, end);
+	i = transformPointsSse2(m, x, y, z, ox, oy, oz, i, end);
+#endif
+	transformPointsRange<float>(m, x, y, z, ox, oy, oz, i, end);
+}
+
+/*
+** mat4MultiplyAvx may write out[i] in place, out may be local.
+*/
+void
+multiplyMatricesRange(Mat4<float> const &parent, Mat4<float> const *local,
+					Mat4<float> *out, size_t i, size_t const &end)
+{
+#if defined(SIMD_DISPATCH)
+	if (simdLevel() >= SIMD_LEVEL_AVX2)
+		return (multiplyMatricesAvx(parent, local, out, i, end));
+#endif
+	multiplyMatricesRange<float>(parent, local, out, i, end);
+}
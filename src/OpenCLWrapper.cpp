@@ -63,8 +63,9 @@ OpenCLWrapper::initKernels(std::vector<std::string> const &kernelFiles,
 	int							err;
 	size_t						len;
 	char						buffer[2048];
-	std::string					file_content;
-	char						*file_string;
+	MappedFile					file;
+	char const					*file_string;
+	size_t						file_size;
 	size_t						i;
 
 	if (kernelFiles.size() != kernelNames.size())
@@ -72,9 +73,13 @@ OpenCLWrapper::initKernels(std::vector<std::string> const &kernelFiles,
 	programNumber = kernelFiles.size();
 	for (i = 0; i < programNumber; ++i)
 	{
-		file_content = getFileContents(kernelFiles[i]);
-		file_string = (char *)file_content.c_str();
-		clPrograms[i] = clCreateProgramWithSource(clContext, 1, (char const **)&file_string, 0, &err);
+		if (!file.open(kernelFiles[i].c_str(), MAPPED_WILLNEED))
+			return (printError(std::ostringstream().flush()
+								<< "Error: Failed to read " << kernelFiles[i] << " !",
+								EXIT_FAILURE));
+		file_string = (char const *)file.data();
+		file_size = file.size();
+		clPrograms[i] = clCreateProgramWithSource(clContext, 1, &file_string, &file_size, &err);
 		if (!clPrograms[i] || err != CL_SUCCESS)
 		{
 			return (printError(std::ostringstream().flush()
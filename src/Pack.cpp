@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Pack.hpp"
+#include "Lz4.hpp"
+#include "Utils.hpp"
+
+std::vector<Pack *>		Pack::mounted;
+
+/* mounted packs outlive main(), and every thread it joined */
+struct Unmount
+{
+	~Unmount(void)
+	{
+		Pack::unmountAll();
+	}
+};
+
+static Unmount			unmountAtExit;
+
+Pack::Pack(void) : entries(0), names(0), mtime()
+{
+	std::memset(&header, 0, sizeof(header));
+	return ;
+}
+
+Pack::~Pack(void)
+{
+	return ;
+}
+
+int
+Pack::error(char const *s)
+{
+	std::cerr << s << std::endl;
+	file.close();
+	entries = 0;
+	names = 0;
+	return (0);
+}
+
+uint64_t
+Pack::hash(std::string const &name)
+{
+	return (fnv1a(name.data(), name.size(), FNV_OFFSET));
+}
+
+std::string
+Pack::normalize(char const *name)
+{
+	std::string		s;
+
+	while (name[0] == '.' && name[1] == '/')
+	{
+		name += 2;
+		while (*name == '/')
+			++name;
+	}
+	while (*name)
+	{
+		if (!(*name == '/' && !s.empty() && s[s.size() - 1] == '/'))
+			s += *name;
+		++name;
+	}
+	return (s);
+}
+
+static bool
+entryLess(PackEntry const &a, PackEntry const &b, char const *names)
+{
+	int			cmp;
+
+	if (a.hash != b.hash)
+		return (a.hash < b.hash);
+	cmp = std::memcmp(names + a.name, names + b.name, std::min(a.nameSize, b.nameSize));
+	return (cmp < 0 || (cmp == 0 && a.nameSize < b.nameSize));
+}
+
+/*
+** Everything an entry points at must lie in the file, and the entries must
+** be in the order find() expects; a pack that passes is never read out of
+** bounds.
+*/
+int
+Pack::validate(void)
+{
+	uint64_t const	total = file.size();
+	uint64_t		dataStart;
+	uint32_t		i;
+
+	if (total < sizeof(PackHeader))
+		return (0);
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (header.magic != PACK_MAGIC || header.version != PACK_VERSION)
+		return (0);
+	dataStart = sizeof(PackHeader) + (uint64_t)sizeof(PackEntry) * header.count
+		+ header.namesSize;
+	if (dataStart > total)
+		return (0);
+	entries = (PackEntry const *)(file.data() + sizeof(PackHeader));
+	names = (char const *)(entries + header.count);
+	i = 0;
+	while (i < header.count)
+	{
+		PackEntry const		&e = entries[i];
+
+		if ((uint64_t)e.name + e.nameSize > header.namesSize
+			|| e.offset < dataStart || e.offset % PACK_ALIGN != 0
+			|| e.offset > total || e.size > total - e.offset
+			|| (!(e.flags & PACK_LZ4) && e.size != e.rawSize)
+			|| ((e.flags & PACK_LZ4) && e.rawSize / PACK_LZ4_RATIO > e.size)
+			|| (e.flags & ~PACK_LZ4) != 0
+			|| e.hash != hash(std::string(names + e.name, e.nameSize))
+			|| (i > 0 && !entryLess(entries[i - 1], e, names)))
+			return (0);
+		++i;
+	}
+	return (1);
+}
+
+int
+Pack::open(char const *filename)
+{
+	struct stat		st;
+
+	if (!file.open(filename, MAPPED_NO_PACK) || ::stat(filename, &st) == -1)
+		return (error(PACK_E1));
+	mtime = STAT_MTIME(st);
+	if (!validate())
+		return (error(PACK_E2));
+	return (1);
+}
+
+PackEntry const *
+Pack::find(std::string const &name) const
+{
+	PackEntry const		*e;
+	PackEntry const		*end;
+	uint64_t const		h = hash(name);
+	uint32_t			lo;
+	uint32_t			hi;
+	uint32_t			mid;
+
+	lo = 0;
+	hi = header.count;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (entries[mid].hash < h)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	e = entries + lo;
+	end = entries + header.count;
+	while (e < end && e->hash == h)
+	{
+		if (e->nameSize == name.size()
+			&& std::memcmp(names + e->name, name.data(), name.size()) == 0)
+			return (e);
+		++e;
+	}
+	return (0);
+}
+
+unsigned char const *
+Pack::data(PackEntry const *entry) const
+{
+	return (file.data() + entry->offset);
+}
+
+int
+Pack::mount(char const *filename)
+{
+	Pack			*pack;
+
+	pack = new Pack();
+	if (!pack->open(filename))
+		return (delete pack, 0);
+	mounted.push_back(pack);
+	return (1);
+}
+
+void
+Pack::unmountAll(void)
+{
+	size_t			i;
+
+	i = 0;
+	while (i < mounted.size())
+		delete mounted[i++];
+	mounted.clear();
+}
+
+PackEntry const *
+Pack::resolve(char const *name, Pack const *&pack)
+{
+	std::string		key;
+	PackEntry const	*e;
+	size_t			i;
+
+	if (mounted.empty())
+		return (0);
+	key = normalize(name);
+	i = mounted.size();
+	while (i-- > 0)
+	{
+		if ((e = mounted[i]->find(key)) != 0)
+		{
+			pack = mounted[i];
+			return (e);
+		}
+	}
+	return (0);
+}
+
+int
+Pack::stat(char const *name, struct stat &st)
+{
+	Pack const		*pack;
+	PackEntry const	*e;
+
+	if ((e = resolve(name, pack)) == 0)
+		return (::stat(name, &st) == 0);
+	std::memset(&st, 0, sizeof(st));
+	st.st_mode = S_IFREG | 0444;
+	st.st_size = e->rawSize;
+	STAT_MTIME(st) = pack->mtime;
+	return (1);
+}
+
+/*
+** Stores the data of an entry at offset, compressed when that is worth it,
+** and fills in what the table needs.
+*/
+static int
+packFile(int fd, std::string const &path, PackEntry &e, uint64_t const &offset,
+	bool const &compress)
+{
+	MappedFile			src;
+	unsigned char		*packed;
+	size_t				size;
+	int					ret;
+
+	if (!src.open(path.c_str(), MAPPED_NO_PACK | MAPPED_SEQUENTIAL))
+		return (0);
+	e.offset = offset;
+	e.rawSize = src.size();
+	e.size = src.size();
+	e.flags = 0;
+	packed = 0;
+	if (compress && src.size() > 0)
+	{
+		packed = new unsigned char[lz4Bound(src.size())];
+		size = lz4Compress(src.data(), src.size(), packed, lz4Bound(src.size()));
+		if (size != 0 && size <= src.size() - src.size() / 8)
+		{
+			e.size = size;
+			e.flags = PACK_LZ4;
+		}
+	}
+	ret = pwriteAll(fd, e.flags & PACK_LZ4 ? packed : src.data(), e.size, offset);
+	delete [] packed;
+	return (ret);
+}
+
+int
+Pack::build(char const *filename, std::vector<std::string> const &files,
+	bool const &compress)
+{
+	std::vector<PackEntry>	toc(files.size());
+	std::vector<size_t>		order(files.size());
+	std::string				blob;
+	std::string				name;
+	std::string				tmp;
+	PackHeader				h;
+	uint64_t				offset;
+	size_t					i;
+	int						fd;
+	int						ret;
+
+	i = 0;
+	while (i < files.size())
+	{
+		name = normalize(files[i].c_str());
+		std::memset(&toc[i], 0, sizeof(PackEntry));
+		toc[i].hash = hash(name);
+		toc[i].name = blob.size();
+		toc[i].nameSize = name.size();
+		blob += name;
+		order[i] = i;
+		++i;
+	}
+	std::sort(order.begin(), order.end(), [&toc, &blob](size_t a, size_t b)
+	{
+		return (entryLess(toc[a], toc[b], blob.data()));
+	});
+	i = 1;
+	while (i < order.size())
+	{
+		if (!entryLess(toc[order[i - 1]], toc[order[i]], blob.data()))
+		{
+			std::cerr << "Packed twice: " << files[order[i]] << std::endl;
+			return (0);
+		}
+		++i;
+	}
+	h.magic = PACK_MAGIC;
+	h.version = PACK_VERSION;
+	h.count = files.size();
+	h.namesSize = blob.size();
+	if ((fd = openTemp(filename, tmp)) == -1)
+	{
+		std::cerr << PACK_E3 << std::endl;
+		return (0);
+	}
+	offset = sizeof(PackHeader) + sizeof(PackEntry) * files.size() + blob.size();
+	ret = 1;
+	i = 0;
+	while (ret && i < order.size())
+	{
+		offset = (offset + PACK_ALIGN - 1) & ~uint64_t(PACK_ALIGN - 1);
+		if (!(ret = packFile(fd, files[order[i]], toc[order[i]], offset, compress)))
+			std::cerr << "Failed to pack " << files[order[i]] << std::endl;
+		offset += toc[order[i]].size;
+		++i;
+	}
+	/* the table in hash order, then the names, then the header last */
+	i = 0;
+	while (ret && i < order.size())
+	{
+		ret = pwriteAll(fd, &toc[order[i]], sizeof(PackEntry),
+			sizeof(PackHeader) + sizeof(PackEntry) * i);
+		++i;
+	}
+	ret = ret && pwriteAll(fd, blob.data(), blob.size(),
+		sizeof(PackHeader) + sizeof(PackEntry) * files.size())
+		&& ftruncate(fd, offset) == 0
+		&& pwriteAll(fd, &h, sizeof(h), 0);
+	if (!(ret = closeTemp(fd, tmp, filename, ret)))
+		std::cerr << PACK_E3 << std::endl;
+	return (ret);
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cerrno>
+#include "ProgramCache.hpp"
+
+ProgramCache::ProgramCache(void) : driver(0)
+{
+	return ;
+}
+
+ProgramCache::~ProgramCache(void)
+{
+	return ;
+}
+
+int
+ProgramCache::init(void)
+{
+	GLenum const	names[4] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+	char const		*s;
+	GLint			count;
+	int				i;
+
+	count = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+	formats.assign(count > 0 ? count : 0, 0);
+	if (count > 0)
+		glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, &formats[0]);
+	driver = FNV_OFFSET;
+	i = 0;
+	while (i < 4)
+	{
+		if ((s = (char const *)glGetString(names[i++])) != NULL)
+			driver = fnv1a(s, std::strlen(s) + 1, driver);
+	}
+	return (!formats.empty());
+}
+
+uint64_t
+ProgramCache::key(char const * const *files, size_t const &count) const
+{
+	MappedFile		file;
+	uint64_t		h;
+	uint64_t		size;
+	size_t			i;
+
+	if (formats.empty())
+		return (0);
+	h = driver;
+	i = 0;
+	while (i < count)
+	{
+		if (!file.open(files[i], MAPPED_SEQUENTIAL))
+			return (0);
+		size = file.size();
+		h = fnv1a(&size, sizeof(size), h);
+		h = fnv1a(file.data(), file.size(), h);
+		++i;
+	}
+	return (h != 0 ? h : 1);
+}
+
+std::string
+ProgramCache::path(char const *name) const
+{
+	return (std::string(PROGRAM_CACHE_DIR) + name + PROGRAM_EXTENSION);
+}
+
+/*
+** A missing or stale file is a miss, not an error; a binary the driver
+** turns down (after a driver update that kept its version string) is
+** reported and compiled again.
+*/
+GLuint
+ProgramCache::load(char const *name, uint64_t const &key) const
+{
+	MappedFile		file;
+	ProgramHeader	h;
+	GLuint			program;
+	GLint			state;
+
+	if (formats.empty() || key == 0 || !file.open(path(name).c_str(), 0)
+		|| file.size() < sizeof(h))
+		return (0);
+	std::memcpy(&h, file.data(), sizeof(h));
+	if (h.magic != PROGRAM_MAGIC || h.version != PROGRAM_VERSION || h.key != key)
+		return (0);
+	if (h.size != file.size() - sizeof(h)
+		|| std::find(formats.begin(), formats.end(), (GLint)h.format) == formats.end())
+		return (printError(PROGRAM_E1, 0));
+	if (!(program = glCreateProgram()))
+		return (0);
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glProgramBinary(program, h.format, file.data() + sizeof(h), h.size);
+	glGetProgramiv(program, GL_LINK_STATUS, &state);
+	if (state != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		std::cerr << "Program binary `" << name << "` rejected, recompiling" << std::endl;
+		return (0);
+	}
+	return (program);
+}
+
+int
+ProgramCache::store(char const *name, uint64_t const &key, GLuint const &program) const
+{
+	std::string const			file = path(name);
+	std::string					tmp;
+	std::vector<unsigned char>	binary;
+	ProgramHeader				h;
+	GLenum						format;
+	GLint						size;
+	GLsizei						length;
+	int							fd;
+	int							ret;
+
+	if (formats.empty() || key == 0)
+		return (0);
+	size = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (size <= 0)
+		return (0);
+	binary.resize(size);
+	length = 0;
+	glGetProgramBinary(program, size, &length, &format, &binary[0]);
+	if (length <= 0)
+		return (0);
+	h.magic = PROGRAM_MAGIC;
+	h.version = PROGRAM_VERSION;
+	h.key = key;
+	h.format = format;
+	h.size = length;
+	if (mkdir(PROGRAM_CACHE_DIR, 0755) == -1 && errno != EEXIST)
+		return (printError(PROGRAM_E2, 0));
+	if ((fd = openTemp(file.c_str(), tmp)) == -1)
+		return (printError(PROGRAM_E2, 0));
+	ret = writeAll(fd, &h, sizeof(h)) && writeAll(fd, &binary[0], length);
+	if (!closeTemp(fd, tmp, file.c_str(), ret))
+		return (printError(PROGRAM_E2, 0));
+	return (1);
+}
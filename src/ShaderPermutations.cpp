@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <cstdio>
+#include "ShaderPermutations.hpp"
+
+typedef void	(*MaxCompilerThreads)(GLuint count);
+
+ShaderPermutations::ShaderPermutations(ProgramCache &cache)
+	: cache(cache), baseKey(0), threads(false)
+{
+	return ;
+}
+
+ShaderPermutations::~ShaderPermutations(void)
+{
+	return ;
+}
+
+/*
+** Reads both sources once, variants only differ by their defines. The
+** cache must have been initialized.
+*/
+int
+ShaderPermutations::init(char const *name, char const *vertexFile, char const *fragmentFile)
+{
+	char const * const	files[2] = { vertexFile, fragmentFile };
+	MaxCompilerThreads	maxThreads;
+	MappedFile			file;
+	std::string			source;
+	size_t				split;
+	int					i;
+
+	this->name = name;
+	i = 0;
+	while (i < 2)
+	{
+		if (!file.open(files[i], MAPPED_WILLNEED))
+		{
+			std::cerr << "Failed to read shader `" << files[i] << "`" << std::endl;
+			return (0);
+		}
+		source.assign((char const *)file.data(), file.size());
+		split = source.find("#version");
+		if (split != std::string::npos)
+			split = std::min(source.find('\n', split), source.size() - 1) + 1;
+		else
+			split = 0;
+		head[i] = source.substr(0, split);
+		body[i] = source.substr(split);
+		line[i] = "#line " + std::to_string(std::count(head[i].begin(), head[i].end(), '\n') + 1)
+			+ "\n";
+		++i;
+	}
+	baseKey = cache.key(files, 2);
+	threads = hasGlExtension("GL_KHR_parallel_shader_compile")
+		|| hasGlExtension("GL_ARB_parallel_shader_compile");
+	maxThreads = (MaxCompilerThreads)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	if (maxThreads == NULL)
+		maxThreads = (MaxCompilerThreads)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	if (threads && maxThreads != NULL)
+		maxThreads(0xFFFFFFFF);
+	return (1);
+}
+
+uint32_t
+ShaderPermutations::feature(char const *define)
+{
+	std::vector<std::string>::iterator	it;
+
+	it = std::find(features.begin(), features.end(), define);
+	if (it != features.end())
+		return (1u << (it - features.begin()));
+	if (features.size() == PERMUTATION_MAX_FEATURES)
+	{
+		std::cerr << PERMUTATION_E1 << ": " << define << std::endl;
+		return (PERMUTATION_NO_FEATURE);
+	}
+	features.push_back(define);
+	return (1u << (features.size() - 1));
+}
+
+bool
+ShaderPermutations::known(uint32_t const &mask) const
+{
+	return ((mask >> features.size()) == 0);
+}
+
+std::string
+ShaderPermutations::defines(uint32_t const &mask) const
+{
+	std::string		s;
+	size_t			i;
+
+	i = 0;
+	while (i < features.size())
+	{
+		if (mask & (1u << i))
+			s += "#define " + features[i] + " 1\n";
+		++i;
+	}
+	return (s);
+}
+
+void
+ShaderPermutations::request(uint32_t const &mask)
+{
+	Variant			v;
+
+	if (!known(mask))
+	{
+		printError(PERMUTATION_E2, 0);
+		return ;
+	}
+	if (variants.count(mask))
+		return ;
+	v.state = VARIANT_QUEUED;
+	v.vertex = 0;
+	v.fragment = 0;
+	v.program = 0;
+	v.key = 0;
+	variants[mask] = v;
+	queue.push_back(mask);
+}
+
+GLuint
+ShaderPermutations::get(uint32_t const &mask)
+{
+	std::unordered_map<uint32_t, Variant>::iterator	it;
+
+	it = variants.find(mask);
+	if (it == variants.end())
+	{
+		if (known(mask))
+			request(mask);
+		return (0);
+	}
+	return (it->second.state == VARIANT_READY ? it->second.program : 0);
+}
+
+GLuint
+ShaderPermutations::wait(uint32_t const &mask)
+{
+	Variant			*v;
+
+	if (!known(mask))
+		return (printError(PERMUTATION_E2, 0));
+	request(mask);
+	v = &variants[mask];
+	if (v->state == VARIANT_QUEUED)
+	{
+		queue.erase(std::find(queue.begin(), queue.end(), mask));
+		start(mask, *v);
+	}
+	advance(mask, *v, true);
+	compiling.erase(std::remove(compiling.begin(), compiling.end(), mask), compiling.end());
+	return (v->state == VARIANT_READY ? v->program : 0);
+}
+
+/*
+** Queued variants start first, so cache hits and variants the driver is
+** quick with are ready this frame.
+*/
+void
+ShaderPermutations::update(void)
+{
+	Variant			*v;
+	size_t			i;
+	size_t			started;
+	size_t			compiles;
+
+	started = 0;
+	compiles = 0;
+	while (!queue.empty() && started < PERMUTATION_STARTS_PER_FRAME
+		&& (threads ? compiling.size() < PERMUTATION_IN_FLIGHT
+			: compiles < PERMUTATION_COMPILES_PER_FRAME))
+	{
+		v = &variants[queue.front()];
+		start(queue.front(), *v);
+		if (v->state == VARIANT_COMPILING)
+		{
+			compiling.push_back(queue.front());
+			++compiles;
+		}
+		queue.pop_front();
+		++started;
+	}
+	i = 0;
+	while (i < compiling.size())
+	{
+		v = &variants[compiling[i]];
+		advance(compiling[i], *v, !threads);
+		if (v->state == VARIANT_READY || v->state == VARIANT_FAILED)
+			compiling.erase(compiling.begin() + i);
+		else
+			++i;
+	}
+}
+
+size_t
+ShaderPermutations::pending(void) const
+{
+	return (queue.size() + compiling.size());
+}
+
+bool
+ShaderPermutations::parallel(void) const
+{
+	return (threads);
+}
+
+GLuint
+ShaderPermutations::compile(GLenum const &type, int const &stage, std::string const &defs)
+{
+	char const		*strings[4];
+	GLint			lengths[4];
+	GLuint			shader;
+
+	if (!(shader = glCreateShader(type)))
+		return (0);
+	strings[0] = head[stage].data();
+	strings[1] = defs.data();
+	strings[2] = line[stage].data();
+	strings[3] = body[stage].data();
+	lengths[0] = head[stage].size();
+	lengths[1] = defs.size();
+	lengths[2] = line[stage].size();
+	lengths[3] = body[stage].size();
+	glShaderSource(shader, 4, strings, lengths);
+	glCompileShader(shader);
+	return (shader);
+}
+
+/*
+** Only issues the work: with the extension, compiling and linking return
+** before the driver is done and nothing here waits for it.
+*/
+void
+ShaderPermutations::start(uint32_t const &mask, Variant &v)
+{
+	std::string const	defs = defines(mask);
+	char				suffix[16];
+
+	snprintf(suffix, sizeof(suffix), "-%08x", mask);
+	v.key = baseKey != 0 ? fnv1a(defs.data(), defs.size(), baseKey) : 0;
+	if ((v.program = cache.load((name + suffix).c_str(), v.key)) != 0)
+	{
+		v.state = VARIANT_READY;
+		return ;
+	}
+	v.vertex = compile(GL_VERTEX_SHADER, 0, defs);
+	v.fragment = compile(GL_FRAGMENT_SHADER, 1, defs);
+	v.state = v.vertex && v.fragment ? VARIANT_COMPILING : VARIANT_FAILED;
+	if (v.state == VARIANT_FAILED)
+		fail(v);
+}
+
+bool
+ShaderPermutations::done(GLuint const &object, bool const &program) const
+{
+	GLint			status;
+
+	status = GL_TRUE;
+	if (program)
+		glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &status);
+	else
+		glGetShaderiv(object, GL_COMPLETION_STATUS_KHR, &status);
+	return (status == GL_TRUE);
+}
+
+static bool
+checkShader(GLuint const &shader, std::string const &name)
+{
+	std::string		log;
+	GLint			state;
+	GLint			size;
+
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &state);
+	if (state == GL_TRUE)
+		return (true);
+	glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &size);
+	log.resize(size > 0 ? size : 1);
+	glGetShaderInfoLog(shader, log.size(), NULL, &log[0]);
+	std::cerr << "Failed to compile shader `" << name << "`: " << std::endl << log.c_str();
+	return (false);
+}
+
+/*
+** Takes a variant as far as the driver is; with block, to the end.
+*/
+void
+ShaderPermutations::advance(uint32_t const &mask, Variant &v, bool const &block)
+{
+	std::string		log;
+	char			suffix[16];
+	GLint			state;
+	GLint			size;
+
+	snprintf(suffix, sizeof(suffix), "-%08x", mask);
+	if (v.state == VARIANT_COMPILING)
+	{
+		if (!block && (!done(v.vertex, false) || !done(v.fragment, false)))
+			return ;
+		if (!checkShader(v.vertex, name + suffix) || !checkShader(v.fragment, name + suffix)
+			|| !(v.program = glCreateProgram()))
+			return (fail(v));
+		glAttachShader(v.program, v.vertex);
+		glAttachShader(v.program, v.fragment);
+		glBindFragDataLocation(v.program, 0, "out_fragment");
+		glProgramParameteri(v.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(v.program);
+		v.state = VARIANT_LINKING;
+	}
+	if (v.state != VARIANT_LINKING || (!block && !done(v.program, true)))
+		return ;
+	glGetProgramiv(v.program, GL_LINK_STATUS, &state);
+	if (state != GL_TRUE)
+	{
+		glGetProgramiv(v.program, GL_INFO_LOG_LENGTH, &size);
+		log.resize(size > 0 ? size : 1);
+		glGetProgramInfoLog(v.program, log.size(), NULL, &log[0]);
+		std::cerr << "Failed to link program `" << name << suffix << "`: " << std::endl
+			<< log.c_str();
+		return (fail(v));
+	}
+	glDeleteShader(v.vertex);
+	glDeleteShader(v.fragment);
+	v.vertex = 0;
+	v.fragment = 0;
+	v.state = VARIANT_READY;
+	cache.store((name + suffix).c_str(), v.key, v.program);
+}
+
+void
+ShaderPermutations::fail(Variant &v)
+{
+	glDeleteShader(v.vertex);
+	glDeleteShader(v.fragment);
+	glDeleteProgram(v.program);
+	v.vertex = 0;
+	v.fragment = 0;
+	v.program = 0;
+	v.state = VARIANT_FAILED;
+}
@@ -0,0 +1,223 @@
+#include "Simd.hpp"
+#include "Swizzle.hpp"
+
+/*
+** Vector loops read and write whole registers, so they stop while enough
+** pixels remain for a full register on both sides; the scalar loops finish
+** the row. Each vector kernel starts at pixel i and returns where it
+** stopped.
+*/
+
+#if defined(SIMD_DISPATCH)
+
+/* pshufb masks, a lane with the high bit set is zeroed */
+static void
+mask24to24(char *m, unsigned char const *order)
+{
+	int				k;
+
+	/* 5 pixels (15 bytes) per register, the last lane is overwritten next */
+	k = 0;
+	while (k < 16)
+	{
+		m[k] = k < 15 ? (char)((k / 3) * 3 + order[k % 3]) : (char)0x80;
+		k++;
+	}
+}
+
+static void
+mask24to32(char *m, unsigned char const *order)
+{
+	int				k;
+
+	/* 4 pixels (12 bytes in, 16 out) per register */
+	k = 0;
+	while (k < 16)
+	{
+		m[k] = (k % 4) < 3 ? (char)((k / 4) * 3 + order[k % 4]) : (char)0x80;
+		k++;
+	}
+}
+
+static void
+mask32to32(char *m, unsigned char const *order)
+{
+	int				k;
+
+	k = 0;
+	while (k < 16)
+	{
+		m[k] = (char)((k / 4) * 4 + order[k % 4]);
+		k++;
+	}
+}
+
+SIMD_TARGET("ssse3") static size_t
+swizzle24to24Ssse3(unsigned char *dst, unsigned char const *src,
+			size_t i, size_t const &count, unsigned char const *order)
+{
+	char			m[16];
+	__m128i			mask;
+
+	mask24to24(m, order);
+	mask = _mm_loadu_si128((__m128i const *)m);
+	while (i + 6 <= count)
+	{
+		_mm_storeu_si128((__m128i *)(dst + i * 3),
+			_mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)(src + i * 3)), mask));
+		i += 5;
+	}
+	return (i);
+}
+
+SIMD_TARGET("ssse3") static size_t
+swizzle24to32Ssse3(unsigned char *dst, unsigned char const *src,
+			size_t i, size_t const &count, unsigned char const *order,
+			unsigned char alpha)
+{
+	char			m[16];
+	__m128i			mask;
+	__m128i			fill;
+
+	mask24to32(m, order);
+	mask = _mm_loadu_si128((__m128i const *)m);
+	fill = _mm_set1_epi32((int)((unsigned int)alpha << 24));
+	while (i + 6 <= count)
+	{
+		_mm_storeu_si128((__m128i *)(dst + i * 4),
+			_mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)(src + i * 3)), mask), fill));
+		i += 4;
+	}
+	return (i);
+}
+
+/* 8 pixels, 4 per 128-bit lane since pshufb does not cross lanes */
+SIMD_TARGET("avx2") static size_t
+swizzle24to32Avx2(unsigned char *dst, unsigned char const *src,
+			size_t i, size_t const &count, unsigned char const *order,
+			unsigned char alpha)
+{
+	char			m[16];
+	__m256i			mask;
+	__m256i			fill;
+	__m256i			v;
+
+	mask24to32(m, order);
+	mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *)m));
+	fill = _mm256_set1_epi32((int)((unsigned int)alpha << 24));
+	while (i + 10 <= count)
+	{
+		v = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((__m128i const *)(src + i * 3))),
+			_mm_loadu_si128((__m128i const *)(src + i * 3 + 12)), 1);
+		_mm256_storeu_si256((__m256i *)(dst + i * 4),
+			_mm256_or_si256(_mm256_shuffle_epi8(v, mask), fill));
+		i += 8;
+	}
+	return (i);
+}
+
+SIMD_TARGET("ssse3") static size_t
+swizzle32to32Ssse3(unsigned char *dst, unsigned char const *src,
+			size_t i, size_t const &count, unsigned char const *order)
+{
+	char			m[16];
+	__m128i			mask;
+
+	mask32to32(m, order);
+	mask = _mm_loadu_si128((__m128i const *)m);
+	while (i + 4 <= count)
+	{
+		_mm_storeu_si128((__m128i *)(dst + i * 4),
+			_mm_shuffle_epi8(_mm_loadu_si128((__m128i const *)(src + i * 4)), mask));
+		i += 4;
+	}
+	return (i);
+}
+
+SIMD_TARGET("avx2") static size_t
+swizzle32to32Avx2(unsigned char *dst, unsigned char const *src,
+			size_t i, size_t const &count, unsigned char const *order)
+{
+	char			m[16];
+	__m256i			mask;
+
+	mask32to32(m, order);
+	mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *)m));
+	while (i + 8 <= count)
+	{
+		_mm256_storeu_si256((__m256i *)(dst + i * 4),
+			_mm256_shuffle_epi8(_mm256_loadu_si256((__m256i const *)(src + i * 4)), mask));
+		i += 8;
+	}
+	return (i);
+}
+
+#endif
+
+void
+swizzle24to24(unsigned char *dst, unsigned char const *src,
+			size_t count, unsigned char const *order)
+{
+	size_t			i;
+
+	i = 0;
+#if defined(SIMD_DISPATCH)
+	if (simdLevel() >= SIMD_LEVEL_SSSE3)
+		i = swizzle24to24Ssse3(dst, src, i, count, order);
+#endif
+	while (i < count)
+	{
+		dst[i * 3] = src[i * 3 + order[0]];
+		dst[i * 3 + 1] = src[i * 3 + order[1]];
+		dst[i * 3 + 2] = src[i * 3 + order[2]];
+		i++;
+	}
+}
+
+void
+swizzle24to32(unsigned char *dst, unsigned char const *src,
+			size_t count, unsigned char const *order,
+			unsigned char alpha)
+{
+	size_t			i;
+
+	i = 0;
+#if defined(SIMD_DISPATCH)
+	if (simdLevel() >= SIMD_LEVEL_AVX2)
+		i = swizzle24to32Avx2(dst, src, i, count, order, alpha);
+	if (simdLevel() >= SIMD_LEVEL_SSSE3)
+		i = swizzle24to32Ssse3(dst, src, i, count, order, alpha);
+#endif
+	while (i < count)
+	{
+		dst[i * 4] = src[i * 3 + order[0]];
+		dst[i * 4 + 1] = src[i * 3 + order[1]];
+		dst[i * 4 + 2] = src[i * 3 + order[2]];
+		dst[i * 4 + 3] = alpha;
+		i++;
+	}
+}
+
+void
+swizzle32to32(unsigned char *dst, unsigned char const *src,
+			size_t count, unsigned char const *order)
+{
+	size_t			i;
+
+	i = 0;
+#if defined(SIMD_DISPATCH)
+	if (simdLevel() >= SIMD_LEVEL_AVX2)
+		i = swizzle32to32Avx2(dst, src, i, count, order);
+	if (simdLevel() >= SIMD_LEVEL_SSSE3)
+		i = swizzle32to32Ssse3(dst, src, i, count, order);
+#endif
+	while (i < count)
+	{
+		dst[i * 4] = src[i * 4 + order[0]];
+		dst[i * 4 + 1] = src[i * 4 + order[1]];
+		dst[i * 4 + 2] = src[i * 4 + order[2]];
+		dst[i * 4 + 3] = src[i * 4 + order[3]];
+		i++;
+	}
+}
@@ -0,0 +1,292 @@
+
+#include <cstdio>
+#include <vector>
+#include "Lz4.hpp"
+#include "BlockCompress.hpp"
+#include "TexFile.hpp"
+#include "Utils.hpp"
+
+TexFile::TexFile(void) : buffer(0)
+{
+	std::memset(&header, 0, sizeof(header));
+	return ;
+}
+
+TexFile::~TexFile(void)
+{
+	unload();
+	return ;
+}
+
+int
+TexFile::error(char const *s)
+{
+	std::cerr << s << std::endl;
+	return (0);
+}
+
+size_t
+TexFile::levelSize(uint32_t const &format, uint32_t const &width, uint32_t const &height)
+{
+	if (format == TEX_BC1)
+		return (bcSize(width, height, BC1_BLOCK_SIZE));
+	if (format == TEX_BC3)
+		return (bcSize(width, height, BC3_BLOCK_SIZE));
+	return ((size_t)width * height * 4);
+}
+
+uint32_t
+TexFile::levelCount(uint32_t const &width, uint32_t const &height)
+{
+	uint32_t		size;
+	uint32_t		count;
+
+	size = width > height ? width : height;
+	count = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		++count;
+	}
+	return (count);
+}
+
+/*
+** Odd sizes clamp the last column or row, it is averaged with itself.
+*/
+void
+TexFile::downsample(unsigned char const *src, uint32_t const &width,
+					uint32_t const &height, unsigned char *dst)
+{
+	uint32_t const	dw = width > 1 ? width / 2 : 1;
+	uint32_t const	dh = height > 1 ? height / 2 : 1;
+	unsigned char const	*r0;
+	unsigned char const	*r1;
+	uint32_t		x0;
+	uint32_t		x1;
+	uint32_t		x;
+	uint32_t		y;
+	int				c;
+
+	y = 0;
+	while (y < dh)
+	{
+		r0 = src + (size_t)(y * 2) * width * 4;
+		r1 = src + (size_t)(y * 2 + 1 < height ? y * 2 + 1 : y * 2) * width * 4;
+		x = 0;
+		while (x < dw)
+		{
+			x0 = x * 2 * 4;
+			x1 = (x * 2 + 1 < width ? x * 2 + 1 : x * 2) * 4;
+			c = 0;
+			while (c < 4)
+			{
+				*dst++ = (unsigned char)((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+				++c;
+			}
+			++x;
+		}
+		++y;
+	}
+}
+
+int
+TexFile::cook(Bmp const &bmp, char const *filename, uint32_t const &flags)
+{
+	static unsigned char const	zeros[TEX_ALIGN] = { 0 };
+	std::vector<unsigned char *>	mips;
+	std::vector<unsigned char *>	blocks;
+	std::vector<unsigned char *>	stored;
+	TexHeader				h;
+	TexLevel				lv[TEX_MAX_LEVELS];
+	std::string				tmp;
+	uint64_t				offset;
+	uint32_t				i;
+	int						fd;
+	int						ret;
+
+	if (bmp.data == 0 || bmp.width == 0 || bmp.height == 0)
+		return (0);
+	h.magic = TEX_MAGIC;
+	h.version = TEX_VERSION;
+	h.format = TEX_RGBA8;
+	if (flags & TEX_BC)
+		h.format = bcOpaque(bmp.data, (size_t)bmp.width * bmp.height) ? TEX_BC1 : TEX_BC3;
+	h.flags = flags & TEX_LZ4;
+	h.width = bmp.width;
+	h.height = bmp.height;
+	h.levels = levelCount(bmp.width, bmp.height);
+	h.reserved = 0;
+	if (h.levels > TEX_MAX_LEVELS)
+		return (0);
+	offset = sizeof(TexHeader) + sizeof(TexLevel) * h.levels;
+	i = 0;
+	while (i < h.levels)
+	{
+		lv[i].width = i == 0 ? h.width : (lv[i - 1].width > 1 ? lv[i - 1].width / 2 : 1);
+		lv[i].height = i == 0 ? h.height : (lv[i - 1].height > 1 ? lv[i - 1].height / 2 : 1);
+		lv[i].rawSize = levelSize(h.format, lv[i].width, lv[i].height);
+		if (i == 0)
+			mips.push_back(bmp.data);
+		else
+		{
+			mips.push_back(new unsigned char[(size_t)lv[i].width * lv[i].height * 4]);
+			downsample(mips[i - 1], lv[i - 1].width, lv[i - 1].height, mips[i]);
+		}
+		if (h.format == TEX_RGBA8)
+			blocks.push_back(mips[i]);
+		else
+		{
+			blocks.push_back(new unsigned char[lv[i].rawSize]);
+			if (h.format == TEX_BC1)
+				bc1Compress(mips[i], lv[i].width, lv[i].height, blocks[i]);
+			else
+				bc3Compress(mips[i], lv[i].width, lv[i].height, blocks[i]);
+		}
+		if (h.flags & TEX_LZ4)
+		{
+			stored.push_back(new unsigned char[lz4Bound(lv[i].rawSize)]);
+			lv[i].size = lz4Compress(blocks[i], lv[i].rawSize, stored[i], lz4Bound(lv[i].rawSize));
+		}
+		else
+		{
+			stored.push_back(blocks[i]);
+			lv[i].size = lv[i].rawSize;
+		}
+		offset = (offset + TEX_ALIGN - 1) & ~uint64_t(TEX_ALIGN - 1);
+		lv[i].offset = offset;
+		offset += lv[i].size;
+		++i;
+	}
+	ret = 0;
+	if ((fd = openTemp(filename, tmp)) != -1)
+	{
+		ret = writeAll(fd, &h, sizeof(h)) && writeAll(fd, lv, sizeof(TexLevel) * h.levels);
+		offset = sizeof(TexHeader) + sizeof(TexLevel) * h.levels;
+		i = 0;
+		while (ret && i < h.levels)
+		{
+			ret = writeAll(fd, zeros, lv[i].offset - offset)
+				&& writeAll(fd, stored[i], lv[i].size);
+			offset = lv[i].offset + lv[i].size;
+			++i;
+		}
+		ret = closeTemp(fd, tmp, filename, ret);
+	}
+	i = 0;
+	while (i < h.levels)
+	{
+		if (stored[i] != blocks[i])
+			delete [] stored[i];
+		if (blocks[i] != mips[i])
+			delete [] blocks[i];
+		if (i > 0)
+			delete [] mips[i];
+		++i;
+	}
+	if (!ret)
+		return (error(TEX_E4));
+	return (1);
+}
+
+/*
+** Every level must have the size its position in the chain implies and
+** lie inside the file, so a truncated or stale cache is rejected and
+** simply cooked again.
+*/
+int
+TexFile::validate(void)
+{
+	uint32_t		i;
+	uint32_t		w;
+	uint32_t		h;
+
+	if (header.magic != TEX_MAGIC || header.version != TEX_VERSION
+		|| header.format > TEX_BC3 || header.width == 0 || header.height == 0
+		|| header.levels == 0 || header.levels > TEX_MAX_LEVELS
+		|| header.levels > levelCount(header.width, header.height)
+		|| file.size() < sizeof(TexHeader) + sizeof(TexLevel) * header.levels)
+		return (0);
+	std::memcpy(levels, file.data() + sizeof(TexHeader), sizeof(TexLevel) * header.levels);
+	w = header.width;
+	h = header.height;
+	i = 0;
+	while (i < header.levels)
+	{
+		if (levels[i].width != w || levels[i].height != h
+			|| levels[i].rawSize != levelSize(header.format, w, h)
+			|| levels[i].offset % TEX_ALIGN != 0
+			|| levels[i].offset > file.size() || levels[i].size > file.size() - levels[i].offset
+			|| (!(header.flags & TEX_LZ4) && levels[i].size != levels[i].rawSize))
+			return (0);
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+		++i;
+	}
+	return (1);
+}
+
+int
+TexFile::load(char const *filename)
+{
+	unload();
+	if (!file.open(filename, MAPPED_WILLNEED))
+		return (error(TEX_E1));
+	return (parse());
+}
+
+int
+TexFile::load(unsigned char *bytes, size_t const &size)
+{
+	unload();
+	file.adopt(bytes, size);
+	return (parse());
+}
+
+int
+TexFile::parse(void)
+{
+	size_t			total;
+	uint32_t		i;
+
+	if (file.size() < sizeof(TexHeader))
+		return (unload(), error(TEX_E2));
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (!validate())
+		return (unload(), error(TEX_E2));
+	if (!(header.flags & TEX_LZ4))
+	{
+		i = 0;
+		while (i < header.levels)
+		{
+			data[i] = file.data() + levels[i].offset;
+			++i;
+		}
+		return (1);
+	}
+	total = 0;
+	i = 0;
+	while (i < header.levels)
+		total += levels[i++].rawSize;
+	buffer = new unsigned char[total];
+	total = 0;
+	i = 0;
+	while (i < header.levels)
+	{
+		if (!lz4Decompress(file.data() + levels[i].offset, levels[i].size, buffer + total, levels[i].rawSize))
+			return (unload(), error(TEX_E3));
+		data[i] = buffer + total;
+		total += levels[i].rawSize;
+		++i;
+	}
+	file.close();
+	return (1);
+}
+
+void
+TexFile::unload(void)
+{
+	file.close();
+	delete [] buffer;
+	buffer = 0;
+}
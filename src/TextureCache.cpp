@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cstdlib>
+#include "TextureCache.hpp"
+
+TextureCache::TextureCache(ThreadPool &pool, TextureLoader &loader, TextureStreamer &streamer)
+	: budget(TEXTURE_CACHE_BUDGET), pool(pool), loader(loader), streamer(streamer), bytes(0),
+	hashing(0)
+{
+	loader.uploaded = [this](GLuint const &texture, size_t const &size) { uploaded(texture, size); };
+	return ;
+}
+
+/*
+** Workers hashing hold pointers to entries, so let them finish. GL
+** objects are left to the context, which may already be destroyed.
+*/
+TextureCache::~TextureCache(void)
+{
+	std::unordered_map<GLuint, Entry *>::iterator	it;
+
+	{
+		std::unique_lock<std::mutex>	lock(mutex);
+
+		while (hashing != 0)
+			cond.wait(lock);
+	}
+	loader.uploaded = TextureLoader::UploadCallback();
+	it = entries.begin();
+	while (it != entries.end())
+	{
+		delete it->second;
+		++it;
+	}
+	return ;
+}
+
+/*
+** The bmp, or its cooked texture when only that one is shipped.
+*/
+static int
+sourceFile(std::string const &path, std::string &file, struct stat &st)
+{
+	file = path;
+	if (Pack::stat(file.c_str(), st))
+		return (1);
+	file = path + TEX_EXTENSION;
+	return (Pack::stat(file.c_str(), st));
+}
+
+/*
+** FNV-1a on 8-byte words, in four independent lanes so the multiplies
+** overlap; the lanes and the size are then folded with FNV-1a too.
+*/
+int
+TextureCache::hashFile(std::string const &filename, uint64_t &hash)
+{
+	MappedFile			file;
+	unsigned char const	*map;
+	uint64_t			lanes[4];
+	uint64_t			word;
+	uint64_t			size;
+	size_t				i;
+	int					l;
+
+	if (!file.open(filename.c_str(), MAPPED_SEQUENTIAL))
+		return (0);
+	map = file.data();
+	l = 0;
+	while (l < 4)
+		lanes[l++] = FNV_OFFSET;
+	i = 0;
+	while (i + 32 <= file.size())
+	{
+		l = 0;
+		while (l < 4)
+		{
+			std::memcpy(&word, map + i + l * 8, 8);
+			lanes[l] = (lanes[l] ^ word) * FNV_PRIME;
+			++l;
+		}
+		i += 32;
+	}
+	lanes[0] = fnv1a(map + i, file.size() - i, lanes[0]);
+	size = file.size();
+	hash = fnv1a(lanes, sizeof(lanes), FNV_OFFSET);
+	hash = fnv1a(&size, sizeof(size), hash);
+	return (1);
+}
+
+/*
+** Paths are made absolute first, so "./a.bmp" and "a.bmp" are one entry;
+** packed names are normalized instead.
+** A new path is loaded at once and hashed on the pool, see update(). A
+** file that cannot be read is still requested, the loader reports the
+** error, but it is not shared.
+*/
+GLuint
+TextureCache::acquire(char const *filename)
+{
+	std::unordered_map<std::string, Source>::iterator	it;
+	std::string			path;
+	std::string			file;
+	char				*real;
+	Pack const			*pack;
+	struct stat			st;
+	Entry				*entry;
+	bool				found;
+
+	/* a packed name shadows the file on disk, which realpath() would find */
+	real = Pack::resolve(filename, pack) == 0 ? realpath(filename, NULL) : NULL;
+	path = real != NULL ? real : Pack::normalize(filename);
+	free(real);
+	found = sourceFile(path, file, st);
+	it = sources.find(path);
+	if (it != sources.end())
+	{
+		entry = it->second.entry;
+		if (found && it->second.size == st.st_size && it->second.mtime == st.st_mtime)
+		{
+			if (entry->refs++ == 0)
+				idle.erase(entry->lru);
+			return (entry->texture);
+		}
+		entry->paths.erase(std::find(entry->paths.begin(), entry->paths.end(), path));
+		sources.erase(it);
+	}
+	entry = new Entry();
+	entry->texture = loader.request(filename);
+	entry->hash = 0;
+	entry->refs = 1;
+	entry->bytes = 0;
+	entry->loaded = false;
+	entry->hashing = found;
+	entry->duplicate = false;
+	entry->file = file;
+	entries[entry->texture] = entry;
+	if (!found)
+		return (entry->texture);
+	entry->paths.push_back(path);
+	sources[path].entry = entry;
+	sources[path].size = st.st_size;
+	sources[path].mtime = st.st_mtime;
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		++hashing;
+	}
+	pool.submit([this, entry]() { hash(entry); });
+	return (entry->texture);
+}
+
+/*
+** Runs on a worker.
+*/
+void
+TextureCache::hash(Entry *entry)
+{
+	bool				ok;
+
+	ok = hashFile(entry->file, entry->hash);
+	std::lock_guard<std::mutex>		lock(mutex);
+
+	hashed.push_back(std::make_pair(entry, ok));
+	--hashing;
+	cond.notify_all();
+}
+
+/*
+** The first entry hashed with some content owns it. A later one is a
+** duplicate: it keeps its texture for those who already hold it, but its
+** paths now lead to the shared texture.
+*/
+void
+TextureCache::update(void)
+{
+	std::deque<std::pair<Entry *, bool>>	done;
+
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		done.swap(hashed);
+	}
+	while (!done.empty())
+	{
+		done.front().first->hashing = false;
+		if (done.front().second)
+			share(done.front().first);
+		done.pop_front();
+	}
+	trim();
+}
+
+void
+TextureCache::share(Entry *entry)
+{
+	std::unordered_map<uint64_t, Entry *>::iterator		same;
+	Entry				*owner;
+	size_t				i;
+
+	same = hashes.find(entry->hash);
+	if (same == hashes.end())
+	{
+		hashes[entry->hash] = entry;
+		return ;
+	}
+	owner = same->second;
+	i = 0;
+	while (i < entry->paths.size())
+	{
+		sources[entry->paths[i]].entry = owner;
+		owner->paths.push_back(entry->paths[i++]);
+	}
+	entry->paths.clear();
+	entry->duplicate = true;
+	if (entry->refs == 0 && entry->loaded)
+		evict(entry);
+}
+
+void
+TextureCache::release(GLuint const &texture)
+{
+	std::unordered_map<GLuint, Entry *>::iterator	it;
+	Entry				*entry;
+
+	it = entries.find(texture);
+	if (it == entries.end() || it->second->refs == 0)
+		return ;
+	entry = it->second;
+	if (--entry->refs != 0)
+		return ;
+	entry->lru = idle.insert(idle.end(), entry);
+	if (entry->duplicate && entry->loaded)
+		evict(entry);
+	else
+		trim();
+}
+
+void
+TextureCache::uploaded(GLuint const &texture, size_t const &size)
+{
+	std::unordered_map<GLuint, Entry *>::iterator	it;
+
+	it = entries.find(texture);
+	if (it == entries.end())
+		return ;
+	it->second->loaded = true;
+	it->second->bytes = size;
+	bytes += size;
+	if (it->second->duplicate && it->second->refs == 0)
+		evict(it->second);
+	else
+		trim();
+}
+
+void
+TextureCache::trim(void)
+{
+	std::list<Entry *>::iterator	it;
+	Entry							*entry;
+
+	it = idle.begin();
+	while (bytes > budget && it != idle.end())
+	{
+		entry = *it;
+		++it;
+		if (entry->loaded && !entry->hashing)
+			evict(entry);
+	}
+}
+
+void
+TextureCache::evict(Entry *entry)
+{
+	std::unordered_map<std::string, Source>::iterator	source;
+	std::unordered_map<uint64_t, Entry *>::iterator		same;
+	size_t				i;
+
+	streamer.cancel(entry->texture);
+	glDeleteTextures(1, &entry->texture);
+	bytes -= entry->bytes;
+	idle.erase(entry->lru);
+	i = 0;
+	while (i < entry->paths.size())
+	{
+		source = sources.find(entry->paths[i++]);
+		if (source != sources.end() && source->second.entry == entry)
+			sources.erase(source);
+	}
+	same = hashes.find(entry->hash);
+	if (same != hashes.end() && same->second == entry)
+		hashes.erase(same);
+	entries.erase(entry->texture);
+	delete entry;
+}
+
+size_t
+TextureCache::size(void) const
+{
+	return (bytes);
+}
+
+size_t
+TextureCache::count(void) const
+{
+	return (entries.size());
+}
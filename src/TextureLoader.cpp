@@ -0,0 +1,304 @@
+
+#include "TextureLoader.hpp"
+
+TextureLoader::TextureLoader(ThreadPool &pool, AssetIO &io, TextureStreamer &streamer)
+	: pool(pool), io(io), streamer(streamer), inFlight(0)
+{
+	return ;
+}
+
+/*
+** Workers and reads hold pointers to this loader, so let them finish. Decoded
+** images that were never uploaded are dropped, the GL context may be
+** gone already.
+*/
+TextureLoader::~TextureLoader(void)
+{
+	wait();
+	while (!done.empty())
+	{
+		delete done.front()->bmp;
+		delete done.front()->tex;
+		delete done.front();
+		done.pop_front();
+	}
+	return ;
+}
+
+GLuint
+TextureLoader::request(char const *filename)
+{
+	Job				*job;
+
+	job = new Job();
+	job->filename = filename;
+	job->bmp = new Bmp();
+	job->tex = 0;
+	job->cached = false;
+	job->fd = -1;
+	job->buffer = 0;
+	job->size = 0;
+	job->result = 0;
+	job->bands = 0;
+	job->failed = 0;
+	glGenTextures(1, &job->texture);
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		++inFlight;
+	}
+	pool.submit([this, job]() { decode(job); });
+	return (job->texture);
+}
+
+/*
+** Runs on a worker. A fresh cooked texture is loaded rather than the bmp.
+*/
+void
+TextureLoader::decode(Job *job)
+{
+	job->cached = cacheIsFresh(job->filename, job->filename + TEX_EXTENSION);
+	read(job);
+}
+
+/*
+** A regular file on disk is read whole through AssetIO, readDone() takes
+** over on the pool. Anything else, a packed name or a file that cannot be
+** opened here, is parsed right away: MappedFile serves packed names from
+** memory and reports the errors.
+*/
+void
+TextureLoader::read(Job *job)
+{
+	std::string const	file = job->cached ? job->filename + TEX_EXTENSION : job->filename;
+	Pack const			*pack;
+	struct stat			st;
+
+	job->buffer = 0;
+	if (Pack::resolve(file.c_str(), pack) != 0
+		|| (job->fd = open(file.c_str(), O_RDONLY)) == -1)
+		return (parse(job));
+	if (fstat(job->fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+	{
+		close(job->fd);
+		return (parse(job));
+	}
+	job->size = st.st_size;
+	job->buffer = new unsigned char[job->size];
+	io.read(job->fd, job->buffer, job->size, 0, TEXTURE_READ_PRIORITY,
+		[this, job](ssize_t const &result)
+		{
+			job->result = result;
+			pool.submit([this, job]() { readDone(job); });
+		});
+}
+
+/*
+** A cooked texture that cannot be read falls back to the bmp, as one that
+** does not parse.
+*/
+void
+TextureLoader::readDone(Job *job)
+{
+	close(job->fd);
+	if (job->result == (ssize_t)job->size)
+		return (parse(job));
+	delete [] job->buffer;
+	job->buffer = 0;
+	if (job->cached)
+	{
+		job->cached = false;
+		return (read(job));
+	}
+	printError(std::string(FILE_E1) + " " + job->filename, 0);
+	job->failed = 1;
+	complete(job);
+}
+
+/*
+** The headers are parsed and the bmp pixel rows split in bands: all bands
+** but the first go back to the pool, the first one is decoded here.
+** Whichever band finishes last drops the file, cooks it and hands the
+** image to the GL thread.
+*/
+void
+TextureLoader::parse(Job *job)
+{
+	std::string const	cache = job->filename + TEX_EXTENSION;
+	uint32_t			bands;
+	uint32_t			first;
+	uint32_t			count;
+	int					ret;
+
+	if (job->cached)
+	{
+		job->tex = new TexFile();
+		ret = job->buffer != 0 ? job->tex->load(job->buffer, job->size)
+			: job->tex->load(cache.c_str());
+		job->buffer = 0;
+		if (ret && streamer.supports(job->tex->header.format))
+		{
+			delete job->bmp;
+			job->bmp = 0;
+			complete(job);
+			return ;
+		}
+		delete job->tex;
+		job->tex = 0;
+		job->cached = false;
+		return (read(job));
+	}
+	ret = job->buffer != 0 ? job->bmp->openBuffer(job->buffer, job->size)
+		: job->bmp->openFile(job->filename.c_str());
+	job->buffer = 0;
+	if (!ret)
+	{
+		job->failed = 1;
+		complete(job);
+		return ;
+	}
+	bands = (job->bmp->height + TEXTURE_BAND_ROWS - 1) / TEXTURE_BAND_ROWS;
+	if (bands <= 1 || job->bmp->sequential())
+	{
+		job->bands = 1;
+		decodeBand(job, 0, job->bmp->height);
+		return ;
+	}
+	job->bands = bands;
+	first = TEXTURE_BAND_ROWS;
+	while (first < job->bmp->height)
+	{
+		count = job->bmp->height - first;
+		if (count > TEXTURE_BAND_ROWS)
+			count = TEXTURE_BAND_ROWS;
+		pool.submit([this, job, first, count]() { decodeBand(job, first, count); });
+		first += count;
+	}
+	decodeBand(job, 0, TEXTURE_BAND_ROWS);
+}
+
+void
+TextureLoader::decodeBand(Job *job, uint32_t const &first, uint32_t const &count)
+{
+	if (!job->bmp->writeData(first, count))
+		job->failed = 1;
+	if (--job->bands == 0)
+	{
+		job->bmp->closeFile();
+		if (!job->failed)
+			cook(job);
+		complete(job);
+	}
+}
+
+/*
+** Writes the cache for the next run and streams from it, so this run
+** already uploads the precomputed mip chain. If the cache cannot be
+** written the bmp is streamed instead.
+*/
+void
+TextureLoader::cook(Job *job)
+{
+	std::string const	cache = job->filename + TEX_EXTENSION;
+
+	if (!TexFile::cook(*job->bmp, cache.c_str(), streamer.supports(TEX_BC1)
+		? TEXTURE_CACHE_FLAGS : TEXTURE_CACHE_FLAGS & ~TEX_BC))
+		return ;
+	job->tex = new TexFile();
+	if (!job->tex->load(cache.c_str()))
+	{
+		delete job->tex;
+		job->tex = 0;
+		return ;
+	}
+	delete job->bmp;
+	job->bmp = 0;
+}
+
+/*
+** Notifies with the lock held: once inFlight reaches 0 the destructor may
+** run, and the condition variable must not be touched after that.
+*/
+void
+TextureLoader::complete(Job *job)
+{
+	std::lock_guard<std::mutex>		lock(mutex);
+
+	done.push_back(job);
+	--inFlight;
+	cond.notify_all();
+}
+
+void
+TextureLoader::wait(void)
+{
+	std::unique_lock<std::mutex>	lock(mutex);
+
+	while (inFlight != 0)
+		cond.wait(lock);
+}
+
+size_t
+TextureLoader::upload(size_t const &maxCount)
+{
+	std::deque<Job *>	jobs;
+	Job					*job;
+	size_t				count;
+	size_t				bytes;
+	uint32_t			i;
+
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		while (!done.empty() && jobs.size() < maxCount)
+		{
+			jobs.push_back(done.front());
+			done.pop_front();
+		}
+	}
+	count = jobs.size();
+	while (!jobs.empty())
+	{
+		job = jobs.front();
+		jobs.pop_front();
+		bytes = 0;
+		if (job->failed)
+		{
+			printError("Failed to load bmp " + job->filename + " !", 0);
+			delete job->bmp;
+		}
+		else if (job->tex != 0)
+		{
+			i = 0;
+			while (i < job->tex->header.levels)
+				bytes += job->tex->levels[i++].rawSize;
+			streamer.push(job->texture, job->tex);
+		}
+		else
+		{
+			/* RGBA, the mipmaps add a third */
+			bytes = (size_t)job->bmp->width * job->bmp->height * 4 * 4 / 3;
+			streamer.push(job->texture, job->bmp);
+		}
+		if (uploaded)
+			uploaded(job->texture, bytes);
+		delete job;
+	}
+	return (count);
+}
+
+void
+TextureLoader::finish(void)
+{
+	wait();
+	upload(size_t(-1));
+	streamer.flush();
+}
+
+size_t
+TextureLoader::pending(void)
+{
+	std::lock_guard<std::mutex>		lock(mutex);
+
+	return (inFlight + done.size());
+}
@@ -0,0 +1,300 @@
+
+#include <algorithm>
+#include "TextureStreamer.hpp"
+
+TextureStreamer::TextureStreamer(void) : budget(TEXTURE_UPLOAD_BUDGET), current(0), s3tc(false)
+{
+	size_t			i;
+
+	i = 0;
+	while (i < TEXTURE_PBO_COUNT)
+	{
+		slots[i].pbo = 0;
+		slots[i].fence = 0;
+		++i;
+	}
+	return ;
+}
+
+/*
+** Images still queued are dropped. GL objects are left to the context,
+** which may already be destroyed at this point.
+*/
+TextureStreamer::~TextureStreamer(void)
+{
+	while (!items.empty())
+	{
+		delete items.front().bmp;
+		delete items.front().tex;
+		items.pop_front();
+	}
+	return ;
+}
+
+int
+TextureStreamer::init(void)
+{
+	size_t			i;
+
+	i = 0;
+	while (i < TEXTURE_PBO_COUNT)
+	{
+		glGenBuffers(1, &slots[i].pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slots[i].pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, TEXTURE_PBO_SIZE, NULL, GL_STREAM_DRAW);
+		++i;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	s3tc = hasGlExtension("GL_EXT_texture_compression_s3tc");
+	return (glGetError() == GL_NO_ERROR);
+}
+
+bool
+TextureStreamer::supports(uint32_t const &format) const
+{
+	return (format == TEX_RGBA8 || s3tc);
+}
+
+void
+TextureStreamer::push(GLuint const &texture, Bmp *bmp)
+{
+	Item			item;
+
+	item.texture = texture;
+	item.bmp = bmp;
+	item.tex = 0;
+	item.levels = 1;
+	item.level = 0;
+	item.row = 0;
+	items.push_back(item);
+}
+
+void
+TextureStreamer::push(GLuint const &texture, TexFile *tex)
+{
+	Item			item;
+
+	if (!supports(tex->header.format))
+	{
+		printError("Texture format not supported by the driver", 0);
+		delete tex;
+		return ;
+	}
+	item.texture = texture;
+	item.bmp = 0;
+	item.tex = tex;
+	item.levels = tex->header.levels;
+	item.level = 0;
+	item.row = 0;
+	items.push_back(item);
+}
+
+void
+TextureStreamer::cancel(GLuint const &texture)
+{
+	std::deque<Item>::iterator	it;
+
+	it = items.begin();
+	while (it != items.end())
+	{
+		if (it->texture == texture)
+		{
+			delete it->bmp;
+			delete it->tex;
+			it = items.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+size_t
+TextureStreamer::update(void)
+{
+	return (stream(budget, false));
+}
+
+void
+TextureStreamer::flush(void)
+{
+	while (!items.empty())
+		stream(size_t(-1), true);
+}
+
+size_t
+TextureStreamer::pending(void) const
+{
+	return (items.size());
+}
+
+/*
+** Returns 0 if the GPU still reads from the slot and wait is false.
+*/
+int
+TextureStreamer::acquire(Slot &slot, bool const &wait)
+{
+	GLenum			status;
+
+	if (slot.fence == 0)
+		return (1);
+	status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+								wait ? GLuint64(1000000000) : 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+		return (0);
+	glDeleteSync(slot.fence);
+	slot.fence = 0;
+	return (1);
+}
+
+/*
+** Levels are streamed in lines: pixel rows for RGBA, rows of 4x4 blocks
+** for BC formats, as compressed uploads must cover whole blocks.
+*/
+void
+TextureStreamer::levelInfo(Item const &item, Level &level)
+{
+	uint32_t		format;
+
+	format = TEX_RGBA8;
+	if (item.tex != 0)
+	{
+		format = item.tex->header.format;
+		level.width = item.tex->levels[item.level].width;
+		level.height = item.tex->levels[item.level].height;
+		level.pixels = item.tex->data[item.level];
+	}
+	else
+	{
+		level.width = item.bmp->width;
+		level.height = item.bmp->height;
+		level.pixels = item.bmp->data;
+	}
+	level.format = 0;
+	if (format == TEX_BC1)
+		level.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	else if (format == TEX_BC3)
+		level.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	level.lineRows = level.format != 0 ? 4 : 1;
+	level.lines = (level.height + level.lineRows - 1) / level.lineRows;
+	level.lineSize = TexFile::levelSize(format, level.width, level.lineRows);
+}
+
+void
+TextureStreamer::allocate(Item const &item, Level const &level, bool const &direct)
+{
+	unsigned char const	*pixels = direct ? level.pixels : NULL;
+
+	glBindTexture(GL_TEXTURE_2D, item.texture);
+	if (level.format != 0)
+		glCompressedTexImage2D(GL_TEXTURE_2D, item.level, level.format, level.width, level.height,
+								0, level.lineSize * level.lines, pixels);
+	else
+		glTexImage2D(GL_TEXTURE_2D, item.level, GL_RGBA, level.width, level.height, 0,
+					GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	if (item.level == 0)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		if (item.tex != 0)
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, item.levels - 1);
+	}
+}
+
+/* lines [first, first + count) from the bound unpack buffer at offset 0 */
+void
+TextureStreamer::upload(Item const &item, Level const &level,
+						uint32_t const &first, uint32_t const &count)
+{
+	uint32_t const	y = first * level.lineRows;
+	uint32_t const	rows = std::min(count * level.lineRows, level.height - y);
+
+	glBindTexture(GL_TEXTURE_2D, item.texture);
+	if (level.format != 0)
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, item.level, 0, y, level.width, rows,
+								level.format, level.lineSize * count, (void *)0);
+	else
+		glTexSubImage2D(GL_TEXTURE_2D, item.level, 0, y, level.width, rows,
+						GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+}
+
+/*
+** At least one line is staged per call even if it exceeds bytes, so an
+** image always makes progress. Small levels and lines larger than a slot
+** are uploaded straight from client memory.
+*/
+size_t
+TextureStreamer::stream(size_t const &bytes, bool const &wait)
+{
+	size_t			done;
+	size_t			fit;
+	uint32_t		lines;
+	Level			level;
+	Item			*item;
+	void			*dst;
+	bool			direct;
+
+	done = 0;
+	while (!items.empty() && (done == 0 || done < bytes))
+	{
+		item = &items.front();
+		levelInfo(*item, level);
+		if (item->row == 0)
+		{
+			direct = level.lineSize > TEXTURE_PBO_SIZE
+				|| level.lineSize * level.lines <= TEXTURE_DIRECT_SIZE;
+			allocate(*item, level, direct);
+			if (direct)
+			{
+				item->row = level.lines;
+				done += level.lineSize * level.lines;
+			}
+		}
+		if (item->row < level.lines)
+		{
+			fit = bytes - done < TEXTURE_PBO_SIZE ? bytes - done : TEXTURE_PBO_SIZE;
+			lines = fit / level.lineSize;
+			if (lines == 0 && done != 0)
+				break ;
+			if (lines == 0)
+				lines = 1;
+			if (!acquire(slots[current], wait))
+				break ;
+			if (lines > level.lines - item->row)
+				lines = level.lines - item->row;
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slots[current].pbo);
+			dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, level.lineSize * lines,
+									GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+									| GL_MAP_UNSYNCHRONIZED_BIT);
+			if (dst == NULL)
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				break ;
+			}
+			std::memcpy(dst, level.pixels + level.lineSize * item->row, level.lineSize * lines);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			upload(*item, level, item->row, lines);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			slots[current].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			current = (current + 1) % TEXTURE_PBO_COUNT;
+			item->row += lines;
+			done += level.lineSize * lines;
+		}
+		if (item->row >= level.lines)
+		{
+			item->row = 0;
+			if (++item->level >= item->levels)
+			{
+				if (item->bmp != 0)
+				{
+					glBindTexture(GL_TEXTURE_2D, item->texture);
+					glGenerateMipmap(GL_TEXTURE_2D);
+				}
+				delete item->bmp;
+				delete item->tex;
+				items.pop_front();
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	return (done);
+}
@@ -0,0 +1,87 @@
+
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(void) : stopping(false)
+{
+	start(std::thread::hardware_concurrency());
+	return ;
+}
+
+ThreadPool::ThreadPool(size_t const &workers) : stopping(false)
+{
+	start(workers);
+	return ;
+}
+
+ThreadPool::~ThreadPool(void)
+{
+	size_t			i;
+
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		stopping = true;
+	}
+	cond.notify_all();
+	i = 0;
+	while (i < threads.size())
+	{
+		threads[i].join();
+		++i;
+	}
+	return ;
+}
+
+void
+ThreadPool::start(size_t workers)
+{
+	size_t			i;
+
+	if (workers == 0)
+		workers = 1;
+	threads.reserve(workers);
+	i = 0;
+	while (i < workers)
+	{
+		threads.push_back(std::thread(&ThreadPool::work, this));
+		++i;
+	}
+}
+
+void
+ThreadPool::submit(std::function<void(void)> const &task)
+{
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		tasks.push_back(task);
+	}
+	cond.notify_one();
+}
+
+size_t
+ThreadPool::size(void) const
+{
+	return (threads.size());
+}
+
+void
+ThreadPool::work(void)
+{
+	std::function<void(void)>		task;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex>	lock(mutex);
+
+			while (!stopping && tasks.empty())
+				cond.wait(lock);
+			if (tasks.empty())
+				return ;
+			task = tasks.front();
+			tasks.pop_front();
+		}
+		task();
+	}
+}
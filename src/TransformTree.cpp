@@ -0,0 +1,156 @@
+
+#include <algorithm>
+#include "TransformTree.hpp"
+
+TransformTree::TransformTree(void)
+{
+	return ;
+}
+
+TransformTree::~TransformTree(void)
+{
+	return ;
+}
+
+/*
+** Appends a node and returns its index. parent is TRANSFORM_ROOT or an
+** existing node, which keeps the arrays topologically sorted.
+** Returns -1 if parent does not exist yet.
+*/
+int
+TransformTree::add(int const &parent, Mat4<float> const &local)
+{
+	if (parent < TRANSFORM_ROOT || parent >= (int)parents.size())
+	{
+		std::cerr << "TransformTree: invalid parent " << parent << std::endl;
+		return (-1);
+	}
+	parents.push_back(parent);
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(1);
+	firstChild.push_back(-1);
+	nextSibling.push_back(parent != TRANSFORM_ROOT ? firstChild[parent] : -1);
+	if (parent != TRANSFORM_ROOT)
+		firstChild[parent] = (int)parents.size() - 1;
+	dirtyRoots.push_back((int)parents.size() - 1);
+	return ((int)parents.size() - 1);
+}
+
+void
+TransformTree::setLocal(int const &node, Mat4<float> const &local)
+{
+	locals[node] = local;
+	if (!dirty[node])
+	{
+		dirty[node] = 1;
+		dirtyRoots.push_back(node);
+	}
+}
+
+Mat4<float> const &
+TransformTree::local(int const &node) const
+{
+	return (locals[node]);
+}
+
+Mat4<float> const &
+TransformTree::world(int const &node) const
+{
+	return (worlds[node]);
+}
+
+/*
+** Recomputes root and everything below it, depth first, and clears the
+** flags of the nodes it reaches.
+*/
+size_t
+TransformTree::updateSubtree(int const &root)
+{
+	size_t			updated;
+	int				node;
+	int				child;
+
+	updated = 0;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		node = stack.back();
+		stack.pop_back();
+		if (parents[node] == TRANSFORM_ROOT)
+			worlds[node] = locals[node];
+		else
+			mat4Multiply(worlds[node].val, worlds[parents[node]].val, locals[node].val);
+		dirty[node] = 0;
+		++updated;
+		child = firstChild[node];
+		while (child != -1)
+		{
+			stack.push_back(child);
+			child = nextSibling[child];
+		}
+	}
+	return (updated);
+}
+
+/*
+** Roots are taken in index order, so an ancestor comes before any dirty
+** node under it, whose flag its walk clears. Returns the number of world
+** matrices recomputed.
+*/
+size_t
+TransformTree::update(void)
+{
+	size_t			updated;
+	size_t			i;
+
+	if (dirtyRoots.empty())
+		return (0);
+	std::sort(dirtyRoots.begin(), dirtyRoots.end());
+	updated = 0;
+	i = 0;
+	while (i < dirtyRoots.size())
+	{
+		if (dirty[dirtyRoots[i]])
+			updated += updateSubtree(dirtyRoots[i]);
+		++i;
+	}
+	dirtyRoots.clear();
+	return (updated);
+}
+
+size_t
+TransformTree::size(void) const
+{
+	return (parents.size());
+}
+
+void
+TransformTree::reserve(size_t const &count)
+{
+	parents.reserve(count);
+	locals.reserve(count);
+	worlds.reserve(count);
+	dirty.reserve(count);
+	firstChild.reserve(count);
+	nextSibling.reserve(count);
+}
+
+void
+TransformTree::clear(void)
+{
+	parents.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	firstChild.clear();
+	nextSibling.clear();
+	dirtyRoots.clear();
+}
+
+std::ostream &
+operator<<(std::ostream &o, TransformTree const &i)
+{
+	o	<< "TransformTree: " << i.size() << " nodes, " << i.dirtyRoots.size() << " dirty";
+	return (o);
+}
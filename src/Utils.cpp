@@ -1,52 +1,114 @@
 
+#include <cstdlib>
 #include "Utils.hpp"
 
-char *
-readFile(char const *filename)
+/*
+** A cooked file is used if it is at least as recent as its source, or if
+** the source is gone (a shipped build may only have the caches). Both are
+** looked up as MappedFile::open() would, in the mounted packs first.
+** Nanoseconds count: a source saved in the second it was cooked is newer.
+*/
+bool
+cacheIsFresh(std::string const &source, std::string const &cache)
 {
-	struct stat		file_stat;
-	int				fd;
-	int				i;
-	int				j;
-	int				ret;
-	char			buf[BUFSIZE];
-	char			*file;
-
-	if ((fd = open(filename, O_RDONLY)) == -1)
-		return ((char *)printError("Failed to open file!"));
-	if (fstat(fd, &file_stat) == -1)
-		return ((char *)printError("Failed to retrieve file stat!"));
-	file = new char[file_stat.st_size + 1];
+	struct stat		src;
+	struct stat		dst;
+
+	if (!Pack::stat(cache.c_str(), dst))
+		return (false);
+	if (!Pack::stat(source.c_str(), src))
+		return (true);
+	if (STAT_MTIME(dst).tv_sec != STAT_MTIME(src).tv_sec)
+		return (STAT_MTIME(dst).tv_sec > STAT_MTIME(src).tv_sec);
+	return (STAT_MTIME(dst).tv_nsec >= STAT_MTIME(src).tv_nsec);
+}
+
+uint64_t
+fnv1a(void const *data, size_t const &size, uint64_t const &h)
+{
+	unsigned char const	*p = (unsigned char const *)data;
+	uint64_t			r;
+	size_t				i;
+
+	r = h;
 	i = 0;
-	while ((ret = read(fd, buf, BUFSIZE)) != 0)
+	while (i < size)
+		r = (r ^ p[i++]) * FNV_PRIME;
+	return (r);
+}
+
+int
+writeAll(int const &fd, void const *buf, size_t size)
+{
+	unsigned char const	*p = (unsigned char const *)buf;
+	ssize_t				n;
+
+	while (size > 0)
+	{
+		n = write(fd, p, size);
+		if (n <= 0)
+			return (0);
+		p += n;
+		size -= n;
+	}
+	return (1);
+}
+
+int
+pwriteAll(int const &fd, void const *buf, size_t size, uint64_t offset)
+{
+	unsigned char const	*p = (unsigned char const *)buf;
+	ssize_t				n;
+
+	while (size > 0)
 	{
-		if (ret == -1)
-			return (close(fd), (char *)printError("Failed to read file!"));
-		j = 0;
-		while (j < ret)
-		{
-			file[i + j] = buf[j];
-			j++;
-		}
-		i += ret;
+		n = pwrite(fd, p, size, offset);
+		if (n <= 0)
+			return (0);
+		p += n;
+		size -= n;
+		offset += n;
 	}
-	file[i] = '\0';
-	close(fd);
-	return (file);
+	return (1);
 }
 
-std::string
-getFileContents(std::string const &filename)
+/*
+** Cooked files and caches are written to a temporary file next to the
+** target and renamed over it by closeTemp() once complete, so a reader
+** never maps half of one. closeTemp() removes the temporary file when
+** written is false or anything fails.
+** The name is unique (mkstemp): two workers cooking the same file each
+** write their own, the last rename wins with a whole file either way.
+*/
+int
+openTemp(char const *filename, std::string &tmp)
 {
-	std::ifstream		in(filename, std::ios::in | std::ios::binary);
-	std::string			contents;
-
-	in.seekg(0, std::ios::end);
-	contents.resize(in.tellg());
-	in.seekg(0, std::ios::beg);
-	in.read(&contents[0], contents.size());
-	in.close();
-	return (contents);
+	int				fd;
+
+	tmp = std::string(filename) + ".XXXXXX";
+	if ((fd = mkstemp(&tmp[0])) == -1)
+		return (-1);
+	if (fchmod(fd, 0644) == -1)
+	{
+		close(fd);
+		unlink(tmp.c_str());
+		return (-1);
+	}
+	return (fd);
+}
+
+int
+closeTemp(int const &fd, std::string const &tmp, char const *filename,
+	bool const &written)
+{
+	int				ret;
+
+	ret = close(fd) == 0 && written;
+	if (ret)
+		ret = rename(tmp.c_str(), filename) == 0;
+	if (!ret)
+		unlink(tmp.c_str());
+	return (ret);
 }
 
 int
@@ -0,0 +1,433 @@
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Simd.hpp"
+#include "FastMath.hpp"
+#include "Mat4Batch.hpp"
+#include "Vec3Array.hpp"
+
+/*
+** Vector width helpers, so every kernel below is written once.
+** Member arrays are aligned, caller provided output arrays are not.
+*/
+#if defined(SIMD_AVX)
+# define VW					(8)
+typedef __m256				vfloat;
+# define vload(p)			_mm256_load_ps(p)
+# define vstoreu(p, v)		_mm256_storeu_ps(p, v)
+# define vstore(p, v)		_mm256_store_ps(p, v)
+# define vset1(s)			_mm256_set1_ps(s)
+# define vadd(a, b)			_mm256_add_ps(a, b)
+# define vsub(a, b)			_mm256_sub_ps(a, b)
+# define vmul(a, b)			_mm256_mul_ps(a, b)
+# define vdiv(a, b)			_mm256_div_ps(a, b)
+# define vsqrt(a)			_mm256_sqrt_ps(a)
+# define vrsqrt(a)			fastRsqrt8(a)
+#elif defined(SIMD_SSE2)
+# define VW					(4)
+typedef __m128				vfloat;
+# define vload(p)			_mm_load_ps(p)
+# define vstoreu(p, v)		_mm_storeu_ps(p, v)
+# define vstore(p, v)		_mm_store_ps(p, v)
+# define vset1(s)			_mm_set1_ps(s)
+# define vadd(a, b)			_mm_add_ps(a, b)
+# define vsub(a, b)			_mm_sub_ps(a, b)
+# define vmul(a, b)			_mm_mul_ps(a, b)
+# define vdiv(a, b)			_mm_div_ps(a, b)
+# define vsqrt(a)			_mm_sqrt_ps(a)
+# define vrsqrt(a)			fastRsqrt4(a)
+#else
+# define VW					(1)
+#endif
+
+Vec3Array::Vec3Array(void) : x(0), y(0), z(0), size(0), capacity(0)
+{
+	return ;
+}
+
+Vec3Array::Vec3Array(size_t const &size) : x(0), y(0), z(0), size(0), capacity(0)
+{
+	resize(size);
+	return ;
+}
+
+Vec3Array::~Vec3Array(void)
+{
+	clear();
+	return ;
+}
+
+/*
+** One allocation holds the three arrays. The capacity is rounded up to
+** VEC3ARRAY_PAD so y and z keep the alignment of x.
+*/
+int
+Vec3Array::reserve(size_t const &capacity)
+{
+	void			*mem;
+	size_t			cap;
+
+	if (capacity <= this->capacity)
+		return (1);
+	cap = (capacity + VEC3ARRAY_PAD - 1) & ~size_t(VEC3ARRAY_PAD - 1);
+	if (posix_memalign(&mem, VEC3ARRAY_ALIGN, cap * 3 * sizeof(float)) != 0)
+		return (0);
+	std::memset(mem, 0, cap * 3 * sizeof(float));
+	if (x != 0)
+	{
+		std::memcpy((float *)mem, x, size * sizeof(float));
+		std::memcpy((float *)mem + cap, y, size * sizeof(float));
+		std::memcpy((float *)mem + cap * 2, z, size * sizeof(float));
+		free(x);
+	}
+	x = (float *)mem;
+	y = x + cap;
+	z = x + cap * 2;
+	this->capacity = cap;
+	return (1);
+}
+
+int
+Vec3Array::resize(size_t const &size)
+{
+	if (!reserve(size))
+		return (0);
+	if (size > this->size)
+	{
+		std::memset(x + this->size, 0, (size - this->size) * sizeof(float));
+		std::memset(y + this->size, 0, (size - this->size) * sizeof(float));
+		std::memset(z + this->size, 0, (size - this->size) * sizeof(float));
+	}
+	this->size = size;
+	return (1);
+}
+
+void
+Vec3Array::clear(void)
+{
+	free(x);
+	x = 0;
+	y = 0;
+	z = 0;
+	size = 0;
+	capacity = 0;
+}
+
+Vec3<float>
+Vec3Array::get(size_t const &i) const
+{
+	return (Vec3<float>(x[i], y[i], z[i]));
+}
+
+void
+Vec3Array::set(size_t const &i, Vec3<float> const &v)
+{
+	x[i] = v.x;
+	y[i] = v.y;
+	z[i] = v.z;
+}
+
+void
+Vec3Array::fill(Vec3<float> const &v)
+{
+	size_t			i;
+
+	i = 0;
+	while (i < size)
+	{
+		x[i] = v.x;
+		y[i] = v.y;
+		z[i] = v.z;
+		++i;
+	}
+}
+
+void
+Vec3Array::add(Vec3Array const &rhs)
+{
+	size_t			i;
+	size_t			n;
+
+	n = std::min(size, rhs.size);
+	i = 0;
+#if VW > 1
+	while (i + VW <= n)
+	{
+		vstore(x + i, vadd(vload(x + i), vload(rhs.x + i)));
+		vstore(y + i, vadd(vload(y + i), vload(rhs.y + i)));
+		vstore(z + i, vadd(vload(z + i), vload(rhs.z + i)));
+		i += VW;
+	}
+#endif
+	while (i < n)
+	{
+		x[i] += rhs.x[i];
+		y[i] += rhs.y[i];
+		z[i] += rhs.z[i];
+		++i;
+	}
+}
+
+void
+Vec3Array::sub(Vec3Array const &rhs)
+{
+	size_t			i;
+	size_t			n;
+
+	n = std::min(size, rhs.size);
+	i = 0;
+#if VW > 1
+	while (i + VW <= n)
+	{
+		vstore(x + i, vsub(vload(x + i), vload(rhs.x + i)));
+		vstore(y + i, vsub(vload(y + i), vload(rhs.y + i)));
+		vstore(z + i, vsub(vload(z + i), vload(rhs.z + i)));
+		i += VW;
+	}
+#endif
+	while (i < n)
+	{
+		x[i] -= rhs.x[i];
+		y[i] -= rhs.y[i];
+		z[i] -= rhs.z[i];
+		++i;
+	}
+}
+
+void
+Vec3Array::scale(float const &s)
+{
+	size_t			i;
+
+	i = 0;
+#if VW > 1
+	vfloat const	vs = vset1(s);
+
+	while (i + VW <= size)
+	{
+		vstore(x + i, vmul(vload(x + i), vs));
+		vstore(y + i, vmul(vload(y + i), vs));
+		vstore(z + i, vmul(vload(z + i), vs));
+		i += VW;
+	}
+#endif
+	while (i < size)
+	{
+		x[i] *= s;
+		y[i] *= s;
+		z[i] *= s;
+		++i;
+	}
+}
+
+void
+Vec3Array::addScaled(Vec3Array const &rhs, float const &s)
+{
+	size_t			i;
+	size_t			n;
+
+	n = std::min(size, rhs.size);
+	i = 0;
+#if VW > 1
+	vfloat const	vs = vset1(s);
+
+	while (i + VW <= n)
+	{
+		vstore(x + i, vadd(vload(x + i), vmul(vload(rhs.x + i), vs)));
+		vstore(y + i, vadd(vload(y + i), vmul(vload(rhs.y + i), vs)));
+		vstore(z + i, vadd(vload(z + i), vmul(vload(rhs.z + i), vs)));
+		i += VW;
+	}
+#endif
+	while (i < n)
+	{
+		x[i] += rhs.x[i] * s;
+		y[i] += rhs.y[i] * s;
+		z[i] += rhs.z[i] * s;
+		++i;
+	}
+}
+
+void
+Vec3Array::dot(Vec3Array const &rhs, float *out) const
+{
+	size_t			i;
+	size_t			n;
+
+	n = std::min(size, rhs.size);
+	i = 0;
+#if VW > 1
+	while (i + VW <= n)
+	{
+		vstoreu(out + i, vadd(vadd(vmul(vload(x + i), vload(rhs.x + i)),
+									vmul(vload(y + i), vload(rhs.y + i))),
+								vmul(vload(z + i), vload(rhs.z + i))));
+		i += VW;
+	}
+#endif
+	while (i < n)
+	{
+		out[i] = x[i] * rhs.x[i] + y[i] * rhs.y[i] + z[i] * rhs.z[i];
+		++i;
+	}
+}
+
+/*
+** a or b may be this, every lane is read before it is written.
+** Like the other binary operations, stops at the shortest array.
+*/
+void
+Vec3Array::cross(Vec3Array const &a, Vec3Array const &b)
+{
+	size_t			i;
+	size_t			n;
+	float			cx;
+	float			cy;
+	float			cz;
+
+	n = std::min(size, std::min(a.size, b.size));
+	i = 0;
+#if VW > 1
+	vfloat			ax;
+	vfloat			ay;
+	vfloat			az;
+	vfloat			bx;
+	vfloat			by;
+	vfloat			bz;
+
+	while (i + VW <= n)
+	{
+		ax = vload(a.x + i);
+		ay = vload(a.y + i);
+		az = vload(a.z + i);
+		bx = vload(b.x + i);
+		by = vload(b.y + i);
+		bz = vload(b.z + i);
+		vstore(x + i, vsub(vmul(ay, bz), vmul(az, by)));
+		vstore(y + i, vsub(vmul(az, bx), vmul(ax, bz)));
+		vstore(z + i, vsub(vmul(ax, by), vmul(ay, bx)));
+		i += VW;
+	}
+#endif
+	while (i < n)
+	{
+		cx = a.y[i] * b.z[i] - a.z[i] * b.y[i];
+		cy = a.z[i] * b.x[i] - a.x[i] * b.z[i];
+		cz = a.x[i] * b.y[i] - a.y[i] * b.x[i];
+		x[i] = cx;
+		y[i] = cy;
+		z[i] = cz;
+		++i;
+	}
+}
+
+void
+Vec3Array::length(float *out) const
+{
+	size_t			i;
+
+	i = 0;
+#if VW > 1
+	vfloat			vx;
+	vfloat			vy;
+	vfloat			vz;
+
+	while (i + VW <= size)
+	{
+		vx = vload(x + i);
+		vy = vload(y + i);
+		vz = vload(z + i);
+		vstoreu(out + i, vsqrt(vadd(vadd(vmul(vx, vx), vmul(vy, vy)), vmul(vz, vz))));
+		i += VW;
+	}
+#endif
+	while (i < size)
+	{
+		out[i] = sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+		++i;
+	}
+}
+
+void
+Vec3Array::normalize(void)
+{
+	size_t			i;
+	float			h;
+
+	i = 0;
+#if VW > 1
+	vfloat			vx;
+	vfloat			vy;
+	vfloat			vz;
+	vfloat			vh;
+
+	while (i + VW <= size)
+	{
+		vx = vload(x + i);
+		vy = vload(y + i);
+		vz = vload(z + i);
+		vh = vsqrt(vadd(vadd(vmul(vx, vx), vmul(vy, vy)), vmul(vz, vz)));
+		vstore(x + i, vdiv(vx, vh));
+		vstore(y + i, vdiv(vy, vh));
+		vstore(z + i, vdiv(vz, vh));
+		i += VW;
+	}
+#endif
+	while (i < size)
+	{
+		h = sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+		x[i] /= h;
+		y[i] /= h;
+		z[i] /= h;
+		++i;
+	}
+}
+
+void
+Vec3Array::normalizeFast(void)
+{
+	size_t			i;
+	float			h;
+
+	i = 0;
+#if VW > 1
+	vfloat			vx;
+	vfloat			vy;
+	vfloat			vz;
+	vfloat			vh;
+
+	while (i + VW <= size)
+	{
+		vx = vload(x + i);
+		vy = vload(y + i);
+		vz = vload(z + i);
+		vh = vrsqrt(vadd(vadd(vmul(vx, vx), vmul(vy, vy)), vmul(vz, vz)));
+		vstore(x + i, vmul(vx, vh));
+		vstore(y + i, vmul(vy, vh));
+		vstore(z + i, vmul(vz, vh));
+		i += VW;
+	}
+#endif
+	while (i < size)
+	{
+		h = fastRsqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+		x[i] *= h;
+		y[i] *= h;
+		z[i] *= h;
+		++i;
+	}
+}
+
+void
+Vec3Array::transform(Mat4<float> const &m)
+{
+	transformPoints(m, x, y, z, x, y, z, size);
+}
+
+std::ostream &
+operator<<(std::ostream &o, Vec3Array const &i)
+{
+	o	<< "Vec3Array: " << i.size << " / " << i.capacity;
+	return (o);
+}
@@ -0,0 +1,859 @@
+#include <algorithm>
+#include <cmath>
+#include "TexFile.hpp"
+#include "VirtualTexture.hpp"
+
+VirtualTexture::VirtualTexture(ThreadPool &pool, AssetIO &io)
+	: pool(pool), io(io), fd(-1), tableWidth(0), tableHeight(0), frame(0), tableTexture(0),
+	atlasTexture(0), fbo(0), feedbackColor(0), feedbackDepth(0), current(0),
+	feedbackWidth(0), feedbackHeight(0), savedFbo(0), cooked(0), opened(false), inFlight(0)
+{
+	size_t			i;
+
+	i = 0;
+	while (i < VT_FEEDBACK_BUFFERS)
+	{
+		pbos[i] = 0;
+		fences[i] = 0;
+		++i;
+	}
+	return ;
+}
+
+/*
+** Workers and page reads hold pointers to this object, so cancel the reads
+** and let everything finish. GL objects are left to the context, which may
+** already be destroyed.
+*/
+VirtualTexture::~VirtualTexture(void)
+{
+	std::unordered_map<uint32_t, AssetIO::Ticket>::iterator	it;
+
+	it = reads.begin();
+	while (it != reads.end())
+		io.cancel((it++)->second);
+	std::unique_lock<std::mutex>	lock(mutex);
+
+	while (inFlight != 0)
+		cond.wait(lock);
+	while (!loaded.empty())
+	{
+		delete [] loaded.front().pixels;
+		loaded.pop_front();
+	}
+	if (fd != -1)
+		close(fd);
+	return ;
+}
+
+/*
+** Per level state of the cook. window holds the rows of the current row
+** of pages with their borders, [pageRow * PAGE - BORDER, (pageRow + 1) *
+** PAGE + BORDER); pair the even row waiting for the odd one to make a row
+** of the next level.
+*/
+struct VtCookLevel
+{
+	VtLevel						info;
+	uint32_t					row;
+	uint32_t					pageRow;
+	std::vector<unsigned char>	window;
+	std::vector<unsigned char>	pair;
+	std::vector<unsigned char>	down;
+};
+
+/*
+** Writes the pages of the current row of pages, clamping to the edges of
+** the level for the borders.
+*/
+static int
+cookPages(VtCookLevel &lv, int const &fd, unsigned char *page)
+{
+	int64_t const	base = (int64_t)lv.pageRow * VT_PAGE_SIZE - VT_BORDER;
+	int64_t			yy;
+	int64_t			xx;
+	uint32_t		x;
+	uint32_t		px;
+	uint32_t		py;
+	unsigned char	*row;
+
+	x = 0;
+	while (x < lv.info.pagesX)
+	{
+		py = 0;
+		while (py < VT_SLOT_SIZE)
+		{
+			yy = std::min(std::max(base + py, (int64_t)0), (int64_t)lv.info.height - 1);
+			row = &lv.window[(size_t)(yy - base) * lv.info.width * 4];
+			px = 0;
+			while (px < VT_SLOT_SIZE)
+			{
+				xx = (int64_t)x * VT_PAGE_SIZE - VT_BORDER + px;
+				xx = std::min(std::max(xx, (int64_t)0), (int64_t)lv.info.width - 1);
+				std::memcpy(page + ((size_t)py * VT_SLOT_SIZE + px) * 4, row + xx * 4, 4);
+				++px;
+			}
+			++py;
+		}
+		if (!pwriteAll(fd, page, VT_PAGE_BYTES, lv.info.offset
+						+ ((uint64_t)lv.pageRow * lv.info.pagesX + x) * VT_PAGE_BYTES))
+			return (0);
+		++x;
+	}
+	return (1);
+}
+
+/*
+** Feeds one row to level l: pages are written as soon as their bottom
+** border row of the next row of pages is in, and each pair of rows is
+** downsampled into a row of the next level, like TexFile::downsample on
+** the whole image.
+*/
+static int
+cookRow(std::vector<VtCookLevel> &lvs, size_t const &l, unsigned char const *pixels,
+		int const &fd, unsigned char *page)
+{
+	VtCookLevel		&lv = lvs[l];
+	size_t const	rowSize = (size_t)lv.info.width * 4;
+	uint32_t const	r = lv.row++;
+	int64_t			base;
+
+	base = (int64_t)lv.pageRow * VT_PAGE_SIZE - VT_BORDER;
+	std::memcpy(&lv.window[(size_t)(r - base) * rowSize], pixels, rowSize);
+	if (r == base + VT_SLOT_SIZE - 1 || r == lv.info.height - 1)
+	{
+		while (lv.pageRow < lv.info.pagesY
+				&& (r == lv.info.height - 1 || r == base + VT_SLOT_SIZE - 1))
+		{
+			if (!cookPages(lv, fd, page))
+				return (0);
+			std::memmove(&lv.window[0], &lv.window[VT_PAGE_SIZE * rowSize],
+						2 * VT_BORDER * rowSize);
+			lv.pageRow++;
+			base += VT_PAGE_SIZE;
+		}
+	}
+	if (l + 1 >= lvs.size())
+		return (1);
+	if (lv.info.height == 1)
+	{
+		TexFile::downsample(pixels, lv.info.width, 1, &lv.down[0]);
+		return (cookRow(lvs, l + 1, &lv.down[0], fd, page));
+	}
+	if (r % 2 == 0)
+	{
+		std::memcpy(&lv.pair[0], pixels, rowSize);
+		return (1);
+	}
+	std::memcpy(&lv.pair[rowSize], pixels, rowSize);
+	TexFile::downsample(&lv.pair[0], lv.info.width, 2, &lv.down[0]);
+	return (cookRow(lvs, l + 1, &lv.down[0], fd, page));
+}
+
+/*
+** Levels down to the first one that fits in one page, each level's pages
+** following the previous level's.
+*/
+static int
+cookLevels(uint32_t w, uint32_t h, std::vector<VtCookLevel> &lvs)
+{
+	uint64_t		offset;
+	size_t			i;
+
+	do
+	{
+		lvs.push_back(VtCookLevel());
+		lvs.back().info.width = w;
+		lvs.back().info.height = h;
+		lvs.back().info.pagesX = (w + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+		lvs.back().info.pagesY = (h + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+	while ((lvs.back().info.pagesX > 1 || lvs.back().info.pagesY > 1)
+			&& lvs.size() < VT_MAX_LEVELS);
+	if (lvs.back().info.pagesX > 1 || lvs.back().info.pagesY > 1)
+		return (0);
+	offset = sizeof(VtHeader) + sizeof(VtLevel) * lvs.size();
+	i = 0;
+	while (i < lvs.size())
+	{
+		lvs[i].info.offset = offset;
+		offset += (uint64_t)lvs[i].info.pagesX * lvs[i].info.pagesY * VT_PAGE_BYTES;
+		lvs[i].row = 0;
+		lvs[i].pageRow = 0;
+		lvs[i].window.resize((size_t)lvs[i].info.width * VT_SLOT_SIZE * 4);
+		lvs[i].pair.resize((size_t)lvs[i].info.width * 2 * 4);
+		lvs[i].down.resize((size_t)(lvs[i].info.width > 1 ? lvs[i].info.width / 2 : 1) * 4);
+		++i;
+	}
+	return (1);
+}
+
+static int
+cookHeader(std::vector<VtCookLevel> const &lvs, int const &fd)
+{
+	std::vector<VtLevel>	info;
+	VtHeader				h;
+	size_t					i;
+
+	h.magic = VT_MAGIC;
+	h.version = VT_VERSION;
+	h.width = lvs[0].info.width;
+	h.height = lvs[0].info.height;
+	h.levels = lvs.size();
+	h.pageSize = VT_PAGE_SIZE;
+	h.border = VT_BORDER;
+	h.reserved = 0;
+	i = 0;
+	while (i < lvs.size())
+		info.push_back(lvs[i++].info);
+	return (pwriteAll(fd, &h, sizeof(h), 0)
+			&& pwriteAll(fd, &info[0], sizeof(VtLevel) * h.levels, sizeof(h)));
+}
+
+/*
+** The bmp is streamed in bands (see Bmp::stream) and never held whole:
+** memory stays around two rows of pages per level whatever the image
+** height. The levels are laid out once the first band gives the size.
+*/
+int
+VirtualTexture::cook(char const *bmp, char const *filename)
+{
+	std::vector<VtCookLevel>	lvs;
+	std::vector<unsigned char>	page(VT_PAGE_BYTES);
+	Bmp							image;
+	std::string					tmp;
+	int							fd;
+	int							ret;
+
+	if ((fd = openTemp(filename, tmp)) == -1)
+		return (printError(VT_E3, 0));
+	ret = image.stream(bmp, VT_PAGE_SIZE,
+		[&lvs, &image, fd, &page](uint32_t const &, uint32_t const &count,
+									unsigned char const *pixels)
+		{
+			uint32_t	y;
+
+			if (lvs.empty() && (!cookLevels(image.width, image.height, lvs)
+								|| !cookHeader(lvs, fd)))
+				return (0);
+			y = 0;
+			while (y < count)
+			{
+				if (!cookRow(lvs, 0, pixels + (size_t)y * image.width * 4, fd, &page[0]))
+					return (0);
+				++y;
+			}
+			return (1);
+		});
+	if (!closeTemp(fd, tmp, filename, ret && !lvs.empty()))
+		return (printError(VT_E3, 0));
+	return (1);
+}
+
+/*
+** Cooks the page file on the pool if it is missing or older than the bmp,
+** GL objects are created by update() once it is there.
+*/
+int
+VirtualTexture::init(char const *filename, int const &screenWidth, int const &screenHeight)
+{
+	std::string const	source = filename;
+
+	path = source + VT_EXTENSION;
+	feedbackWidth = std::max(screenWidth / VT_FEEDBACK_SCALE, 1);
+	feedbackHeight = std::max(screenHeight / VT_FEEDBACK_SCALE, 1);
+	if (cacheIsFresh(source, path))
+	{
+		cooked = 1;
+		return (1);
+	}
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		++inFlight;
+	}
+	pool.submit([this, source]()
+	{
+		cooked = cook(source.c_str(), path.c_str()) ? 1 : -1;
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		--inFlight;
+		cond.notify_all();
+	});
+	return (1);
+}
+
+/*
+** Every level must have the size its position in the chain implies and
+** every page must lie inside the file.
+*/
+int
+VirtualTexture::openPages(void)
+{
+	struct stat		st;
+	uint64_t		offset;
+	uint32_t		w;
+	uint32_t		h;
+	uint32_t		i;
+
+	if ((fd = open(path.c_str(), O_RDONLY)) == -1)
+		return (printError(VT_E1, 0));
+	if (fstat(fd, &st) == -1 || pread(fd, &header, sizeof(header), 0) != sizeof(header)
+		|| header.magic != VT_MAGIC || header.version != VT_VERSION
+		|| header.pageSize != VT_PAGE_SIZE || header.border != VT_BORDER
+		|| header.levels == 0 || header.levels > VT_MAX_LEVELS
+		|| pread(fd, levels, sizeof(VtLevel) * header.levels, sizeof(header))
+			!= (ssize_t)(sizeof(VtLevel) * header.levels))
+		return (printError(VT_E2, 0));
+	w = header.width;
+	h = header.height;
+	offset = sizeof(VtHeader) + sizeof(VtLevel) * header.levels;
+	i = 0;
+	while (i < header.levels)
+	{
+		if (levels[i].width != w || levels[i].height != h || levels[i].offset != offset
+			|| levels[i].pagesX != (w + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE
+			|| levels[i].pagesY != (h + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE)
+			return (printError(VT_E2, 0));
+		firstPage[i] = i == 0 ? 0 : firstPage[i - 1] + levels[i - 1].pagesX * levels[i - 1].pagesY;
+		offset += (uint64_t)levels[i].pagesX * levels[i].pagesY * VT_PAGE_BYTES;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+		++i;
+	}
+	i = header.levels - 1;
+	if (offset > (uint64_t)st.st_size || levels[i].pagesX != 1 || levels[i].pagesY != 1)
+		return (printError(VT_E2, 0));
+	return (1);
+}
+
+/*
+** The page table is sized to powers of two so that its GL mip chain has a
+** level for every level of pages: pages(n) = ceil(pages(0) / 2^n) never
+** exceeds pow2(pages(0)) >> n.
+*/
+static uint32_t
+nextPow2(uint32_t v)
+{
+	uint32_t		p;
+
+	p = 1;
+	while (p < v)
+		p <<= 1;
+	return (p);
+}
+
+static GLuint
+createTexture(GLenum const &filter)
+{
+	GLuint			texture;
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	return (texture);
+}
+
+/*
+** Creates the GL objects and makes the last level resident in slot 0,
+** where it stays: every entry of the page table starts out pointing to it.
+*/
+int
+VirtualTexture::openGl(void)
+{
+	Load			top;
+	uint32_t		pages;
+	uint32_t		l;
+	size_t			i;
+
+	pages = firstPage[header.levels - 1] + 1;
+	states.assign(pages, PAGE_ABSENT);
+	slotOf.assign(pages, -1);
+	seen.assign(pages, 0);
+	slots.resize(VT_ATLAS_PAGES * VT_ATLAS_PAGES);
+	i = 0;
+	while (i < slots.size())
+	{
+		slots[i].page = -1;
+		slots[i++].used = 0;
+	}
+	tableWidth = nextPow2(levels[0].pagesX);
+	tableHeight = nextPow2(levels[0].pagesY);
+	tableTexture = createTexture(GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levels - 1);
+	l = 0;
+	while (l < header.levels)
+	{
+		table[l].assign((size_t)std::max(tableWidth >> l, 1U) * std::max(tableHeight >> l, 1U), 0);
+		glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8UI, std::max(tableWidth >> l, 1U),
+					std::max(tableHeight >> l, 1U), 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &table[l][0]);
+		dirty[l][0] = UINT32_MAX;
+		dirty[l][1] = UINT32_MAX;
+		dirty[l][2] = 0;
+		dirty[l][3] = 0;
+		++l;
+	}
+	atlasTexture = createTexture(GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, VT_ATLAS_PAGES * VT_SLOT_SIZE,
+				VT_ATLAS_PAGES * VT_SLOT_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	feedbackColor = createTexture(GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, feedbackWidth, feedbackHeight, 0,
+				GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glGenRenderbuffers(1, &feedbackDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFbo);
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackColor, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+	l = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, savedFbo);
+	if (!l)
+		return (printError("Incomplete virtual texture feedback framebuffer !", 0));
+	glGenBuffers(VT_FEEDBACK_BUFFERS, pbos);
+	i = 0;
+	while (i < VT_FEEDBACK_BUFFERS)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i++]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)feedbackWidth * feedbackHeight * 4,
+					NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	top.page = firstPage[header.levels - 1];
+	top.pixels = new unsigned char[VT_PAGE_BYTES];
+	if (!readPage(top.page, top.pixels))
+	{
+		delete [] top.pixels;
+		return (printError(VT_E1, 0));
+	}
+	states[top.page] = PAGE_LOADING;
+	place(top);
+	slots[slotOf[top.page]].used = UINT64_MAX;
+	uploadTable();
+	return (glGetError() == GL_NO_ERROR);
+}
+
+bool
+VirtualTexture::ready(void) const
+{
+	return (opened);
+}
+
+uint32_t
+VirtualTexture::resident(void) const
+{
+	uint32_t		count;
+	size_t			i;
+
+	count = 0;
+	i = 0;
+	while (i < slots.size())
+		count += slots[i++].page != -1;
+	return (count);
+}
+
+uint32_t
+VirtualTexture::levelOf(uint32_t const &page) const
+{
+	uint32_t		l;
+
+	l = header.levels - 1;
+	while (l > 0 && page < firstPage[l])
+		--l;
+	return (l);
+}
+
+int
+VirtualTexture::readPage(uint32_t const &page, unsigned char *pixels) const
+{
+	uint32_t const	l = levelOf(page);
+
+	return (pread(fd, pixels, VT_PAGE_BYTES, levels[l].offset
+					+ (uint64_t)(page - firstPage[l]) * VT_PAGE_BYTES) == (ssize_t)VT_PAGE_BYTES);
+}
+
+/*
+** Opens the page file once it is cooked, then: reads back the feedback of
+** previous frames, cancels the reads of pages no longer seen, copies the
+** pages read since the last call into the atlas and uploads the page
+** table entries that changed.
+*/
+void
+VirtualTexture::update(void)
+{
+	std::unordered_map<uint32_t, AssetIO::Ticket>::iterator	it;
+	Load			done;
+	size_t			count;
+
+	if (!opened)
+	{
+		if (cooked != 1)
+			return ;
+		if (!openPages() || !openGl())
+		{
+			cooked = -1;
+			return ;
+		}
+		opened = true;
+	}
+	++frame;
+	readFeedback();
+	it = reads.begin();
+	while (it != reads.end())
+	{
+		if (seen[it->first] + VT_STALE_FRAMES < frame)
+			io.cancel(it->second);
+		++it;
+	}
+	count = 0;
+	while (count < VT_UPLOADS_PER_FRAME)
+	{
+		{
+			std::lock_guard<std::mutex>		lock(mutex);
+
+			if (loaded.empty())
+				break ;
+			done = loaded.front();
+			loaded.pop_front();
+		}
+		reads.erase(done.page);
+		if (done.pixels != 0)
+		{
+			place(done);
+			++count;
+		}
+		else
+			states[done.page] = PAGE_ABSENT;
+	}
+	uploadTable();
+}
+
+/*
+** The feedback of a frame is read back into a pixel buffer by
+** endFeedback() and only mapped here once its fence is signaled, a frame
+** or two later, so the GPU is never waited for.
+*/
+void
+VirtualTexture::readFeedback(void)
+{
+	size_t			i;
+	size_t			n;
+	void const		*texels;
+
+	n = 0;
+	while (n < VT_FEEDBACK_BUFFERS)
+	{
+		i = (current + n++) % VT_FEEDBACK_BUFFERS;
+		if (fences[i] == 0
+			|| glClientWaitSync(fences[i], 0, 0) == GL_TIMEOUT_EXPIRED)
+			continue ;
+		glDeleteSync(fences[i]);
+		fences[i] = 0;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+		texels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+									(size_t)feedbackWidth * feedbackHeight * 4, GL_MAP_READ_BIT);
+		if (texels != NULL)
+		{
+			parseFeedback((uint32_t const *)texels, (size_t)feedbackWidth * feedbackHeight);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+}
+
+/*
+** Texels are x | y << 12 | level << 24 | 1 << 31 (see vtFeedback). Each
+** page seen, and every page above it in the chain, is marked used this
+** frame; those missing are read through AssetIO, coarse levels first so
+** a closer fallback shows up quickly, at most VT_REQUESTS_PER_FRAME per
+** call.
+*/
+void
+VirtualTexture::parseFeedback(uint32_t const *texels, size_t const &count)
+{
+	std::vector<std::pair<uint32_t, uint32_t> >	wanted;
+	uint32_t		x;
+	uint32_t		y;
+	uint32_t		l;
+	uint32_t		page;
+	size_t			i;
+
+	i = 0;
+	while (i < count)
+	{
+		x = texels[i] & 0xFFF;
+		y = (texels[i] >> 12) & 0xFFF;
+		l = (texels[i] >> 24) & 0x1F;
+		if (!(texels[i++] & (1U << 31)) || l >= header.levels
+			|| x >= levels[l].pagesX || y >= levels[l].pagesY)
+			continue ;
+		while (l < header.levels)
+		{
+			page = firstPage[l] + y * levels[l].pagesX + x;
+			if (seen[page] == frame)
+				break ;
+			seen[page] = frame;
+			if (states[page] == PAGE_RESIDENT && slots[slotOf[page]].used != UINT64_MAX)
+				slots[slotOf[page]].used = frame;
+			else if (states[page] == PAGE_ABSENT)
+				wanted.push_back(std::make_pair(header.levels - l, page));
+			x >>= 1;
+			y >>= 1;
+			++l;
+		}
+	}
+	std::sort(wanted.begin(), wanted.end());
+	i = 0;
+	while (i < wanted.size() && i < VT_REQUESTS_PER_FRAME)
+		load(wanted[i++].second);
+}
+
+/* coarser levels have a higher priority, as in parseFeedback() */
+void
+VirtualTexture::load(uint32_t const &page)
+{
+	uint32_t const	l = levelOf(page);
+	Load			done;
+
+	states[page] = PAGE_LOADING;
+	done.page = page;
+	done.pixels = new unsigned char[VT_PAGE_BYTES];
+	{
+		std::lock_guard<std::mutex>		lock(mutex);
+
+		++inFlight;
+	}
+	reads[page] = io.read(fd, done.pixels, VT_PAGE_BYTES, levels[l].offset
+						+ (uint64_t)(page - firstPage[l]) * VT_PAGE_BYTES, l,
+						[this, done](ssize_t const &size) { complete(done, size); });
+}
+
+/*
+** Runs where AssetIO completes the read, pixels is 0 if it failed or was
+** canceled. Notifies with the lock held, as TextureLoader::complete.
+*/
+void
+VirtualTexture::complete(Load done, ssize_t const &size)
+{
+	if (size != (ssize_t)VT_PAGE_BYTES)
+	{
+		delete [] done.pixels;
+		done.pixels = 0;
+	}
+	std::lock_guard<std::mutex>		lock(mutex);
+
+	loaded.push_back(done);
+	--inFlight;
+	cond.notify_all();
+}
+
+/*
+** A free slot, or the one whose page was seen the longest ago, as long as
+** it was not seen this frame. -1 if the atlas only holds pages in use.
+*/
+int32_t
+VirtualTexture::allocate(void)
+{
+	int32_t			best;
+	size_t			i;
+
+	best = -1;
+	i = 0;
+	while (i < slots.size())
+	{
+		if (slots[i].page == -1)
+			return (i);
+		if (slots[i].used < frame && (best == -1 || slots[i].used < slots[best].used))
+			best = i;
+		++i;
+	}
+	return (best);
+}
+
+void
+VirtualTexture::evict(int32_t const &slot)
+{
+	uint32_t const	page = slots[slot].page;
+	uint32_t const	l = levelOf(page);
+	uint32_t const	i = page - firstPage[l];
+
+	states[page] = PAGE_ABSENT;
+	slotOf[page] = -1;
+	slots[slot].page = -1;
+	refresh(l, i % levels[l].pagesX, i / levels[l].pagesX);
+}
+
+/*
+** Pages are small (VT_PAGE_BYTES), they are copied straight from client
+** memory as the streamer does for small levels.
+*/
+void
+VirtualTexture::place(Load const &done)
+{
+	uint32_t const	l = levelOf(done.page);
+	uint32_t const	i = done.page - firstPage[l];
+	int32_t			slot;
+
+	slot = -1;
+	if (states[done.page] == PAGE_LOADING)
+		slot = allocate();
+	if (slot == -1)
+	{
+		if (states[done.page] == PAGE_LOADING)
+			states[done.page] = PAGE_ABSENT;
+		delete [] done.pixels;
+		return ;
+	}
+	if (slots[slot].page != -1)
+		evict(slot);
+	glBindTexture(GL_TEXTURE_2D, atlasTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % VT_ATLAS_PAGES) * VT_SLOT_SIZE,
+					(slot / VT_ATLAS_PAGES) * VT_SLOT_SIZE, VT_SLOT_SIZE, VT_SLOT_SIZE,
+					GL_RGBA, GL_UNSIGNED_BYTE, done.pixels);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	delete [] done.pixels;
+	states[done.page] = PAGE_RESIDENT;
+	slotOf[done.page] = slot;
+	slots[slot].page = done.page;
+	slots[slot].used = frame;
+	refresh(l, i % levels[l].pagesX, i / levels[l].pagesX);
+}
+
+/*
+** Recomputes the entries under page (x, y) of level, finest last: a
+** resident page points to itself, any other one inherits the entry of the
+** page above it. Entries are slot x, slot y, level, 1.
+*/
+void
+VirtualTexture::refresh(uint32_t const &level, uint32_t const &x, uint32_t const &y)
+{
+	uint32_t		l;
+	uint32_t		x0;
+	uint32_t		y0;
+	uint32_t		x1;
+	uint32_t		y1;
+	uint32_t		px;
+	uint32_t		py;
+	uint32_t		page;
+	uint32_t		stride;
+	int32_t			slot;
+
+	l = level + 1;
+	while (l-- > 0)
+	{
+		stride = std::max(tableWidth >> l, 1U);
+		x0 = x << (level - l);
+		y0 = y << (level - l);
+		x1 = std::min((x + 1) << (level - l), levels[l].pagesX);
+		y1 = std::min((y + 1) << (level - l), levels[l].pagesY);
+		py = y0;
+		while (py < y1)
+		{
+			px = x0;
+			while (px < x1)
+			{
+				page = firstPage[l] + py * levels[l].pagesX + px;
+				slot = slotOf[page];
+				if (slot != -1)
+					table[l][py * stride + px] = (slot % VT_ATLAS_PAGES)
+						| ((slot / VT_ATLAS_PAGES) << 8) | (l << 16) | (1U << 24);
+				else if (l + 1 < header.levels)
+					table[l][py * stride + px] = table[l + 1][(py >> 1)
+						* std::max(tableWidth >> (l + 1), 1U) + (px >> 1)];
+				++px;
+			}
+			++py;
+		}
+		dirty[l][0] = std::min(dirty[l][0], x0);
+		dirty[l][1] = std::min(dirty[l][1], y0);
+		dirty[l][2] = std::max(dirty[l][2], x1);
+		dirty[l][3] = std::max(dirty[l][3], y1);
+	}
+}
+
+void
+VirtualTexture::uploadTable(void)
+{
+	uint32_t		l;
+
+	glBindTexture(GL_TEXTURE_2D, tableTexture);
+	l = 0;
+	while (l < header.levels)
+	{
+		if (dirty[l][0] < dirty[l][2])
+		{
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, std::max(tableWidth >> l, 1U));
+			glTexSubImage2D(GL_TEXTURE_2D, l, dirty[l][0], dirty[l][1],
+							dirty[l][2] - dirty[l][0], dirty[l][3] - dirty[l][1],
+							GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+							&table[l][dirty[l][1] * std::max(tableWidth >> l, 1U) + dirty[l][0]]);
+			dirty[l][0] = UINT32_MAX;
+			dirty[l][1] = UINT32_MAX;
+			dirty[l][2] = 0;
+			dirty[l][3] = 0;
+		}
+		++l;
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+int
+VirtualTexture::beginFeedback(void)
+{
+	static GLuint const	none[4] = { 0, 0, 0, 0 };
+
+	if (!opened || fences[current] != 0)
+		return (0);
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &savedFbo);
+	glGetIntegerv(GL_VIEWPORT, savedViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, feedbackWidth, feedbackHeight);
+	glClearBufferuiv(GL_COLOR, 0, none);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	return (1);
+}
+
+void
+VirtualTexture::endFeedback(void)
+{
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[current]);
+	glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, (void *)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	current = (current + 1) % VT_FEEDBACK_BUFFERS;
+	glBindFramebuffer(GL_FRAMEBUFFER, savedFbo);
+	glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+}
+
+/*
+** The feedback pass samples at a lower resolution, so its derivatives are
+** VT_FEEDBACK_SCALE times larger: vt_bias brings the level back to what
+** the full resolution pass will pick.
+*/
+void
+VirtualTexture::bind(GLuint const &program, GLint const &tableUnit,
+					GLint const &atlasUnit, bool const &feedback) const
+{
+	glActiveTexture(GL_TEXTURE0 + tableUnit);
+	glBindTexture(GL_TEXTURE_2D, tableTexture);
+	glActiveTexture(GL_TEXTURE0 + atlasUnit);
+	glBindTexture(GL_TEXTURE_2D, atlasTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, "vt_table"), tableUnit);
+	glUniform1i(glGetUniformLocation(program, "vt_atlas"), atlasUnit);
+	glUniform2i(glGetUniformLocation(program, "vt_size"), header.width, header.height);
+	glUniform1i(glGetUniformLocation(program, "vt_levels"), opened ? header.levels : 0);
+	glUniform1f(glGetUniformLocation(program, "vt_slots"), VT_ATLAS_PAGES);
+	glUniform1f(glGetUniformLocation(program, "vt_bias"),
+				feedback ? -std::log2((float)VT_FEEDBACK_SCALE) : 0.0f);
+}
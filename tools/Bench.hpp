@@ -0,0 +1,57 @@
+#ifndef BENCH_HPP
+# define BENCH_HPP
+
+# include <chrono>
+# include <iomanip>
+# include <iostream>
+
+# define BENCH_RUNS				(5)
+
+/*
+** Helpers for the tools/bench_*.cpp programs built by make bench: each
+** case runs BENCH_RUNS times and the fastest run is reported, in ms.
+*/
+
+/* keeps the compiler from dropping a result nothing reads */
+inline void
+benchKeep(void const *p)
+{
+	__asm__ __volatile__("" : : "g"(p) : "memory");
+}
+
+template<typename F>
+inline double
+benchRun(F const &f)
+{
+	std::chrono::steady_clock::time_point	start;
+	double									best;
+	double									ms;
+	int										i;
+
+	best = 0;
+	i = 0;
+	while (i < BENCH_RUNS)
+	{
+		start = std::chrono::steady_clock::now();
+		f();
+		ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+			- start).count();
+		if (i == 0 || ms < best)
+			best = ms;
+		++i;
+	}
+	return (best);
+}
+
+/* prints the case, its time and, given a reference time, the speedup */
+inline void
+benchReport(char const *name, double const &ms, double const &reference = 0)
+{
+	std::cout << std::left << std::setw(32) << name << std::right << std::fixed
+		<< std::setprecision(2) << std::setw(10) << ms << " ms";
+	if (reference > 0)
+		std::cout << std::setw(8) << reference / ms << "x";
+	std::cout << std::endl;
+}
+
+#endif
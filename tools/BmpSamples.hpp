@@ -0,0 +1,278 @@
+#ifndef BMPSAMPLES_HPP
+# define BMPSAMPLES_HPP
+
+# include <vector>
+# include <stdint.h>
+# include "Bmp.hpp"
+
+/*
+** Generated BMP files for the bench_bmp and fuzz_bmp tools: one of each
+** layout Bmp decodes, with runs of equal pixels so RLE has something to
+** compress. expected holds the RGBA pixels Bmp must decode, bottom row
+** first, for the lossless layouts.
+*/
+
+struct BmpLayout
+{
+	char const *		name;
+	uint32_t			bpp;
+	uint32_t			compression;
+	/* R, G, B, A masks of the BITFIELDS layouts */
+	uint32_t			masks[4];
+	/* Bmp decodes exactly the generated pixels */
+	bool				lossless;
+};
+
+static BmpLayout const	bmpLayouts[] =
+{
+	{ "24 bpp", 24, BI_RGB, { 0, 0, 0, 0 }, true },
+	{ "32 bpp BITFIELDS 8888", 32, BI_BITFIELDS,
+		{ 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 }, true },
+	{ "32 bpp BITFIELDS 10.10.10.2", 32, BI_BITFIELDS,
+		{ 0x3FF00000, 0x000FFC00, 0x000003FF, 0xC0000000 }, false },
+	{ "16 bpp BITFIELDS 565", 16, BI_BITFIELDS,
+		{ 0xF800, 0x07E0, 0x001F, 0 }, false },
+	{ "16 bpp 555", 16, BI_RGB, { 0, 0, 0, 0 }, false },
+	{ "8 bpp palette", 8, BI_RGB, { 0, 0, 0, 0 }, true },
+	{ "4 bpp palette", 4, BI_RGB, { 0, 0, 0, 0 }, true },
+	{ "1 bpp palette", 1, BI_RGB, { 0, 0, 0, 0 }, true },
+	{ "RLE8", 8, BI_RLE8, { 0, 0, 0, 0 }, true },
+	{ "RLE4", 4, BI_RLE4, { 0, 0, 0, 0 }, true },
+};
+
+# define BMP_LAYOUTS			(sizeof(bmpLayouts) / sizeof(bmpLayouts[0]))
+
+class BmpSample
+{
+public:
+	std::vector<unsigned char>	file;
+	std::vector<unsigned char>	expected;
+
+	BmpSample(BmpLayout const &layout, uint32_t const &width, uint32_t const &height,
+			uint32_t const &seed, bool const &top_down = false)
+		: layout(layout), width(width), height(height), state(seed), run(0), value(0)
+	{
+		uint32_t const	colors = layout.bpp <= 8 ? 1U << layout.bpp : 0;
+		uint32_t const	masks = layout.compression == BI_BITFIELDS ? 16 : 0;
+		uint32_t		offset;
+		uint32_t		i;
+
+		offset = BMP_HSIZE + DIB_HSIZE + masks + colors * 4;
+		file.resize(offset);
+		put(0, 'B' | ('M' << 8), 2);
+		put(10, offset, 4);
+		put(14, DIB_HSIZE, 4);
+		put(18, width, 4);
+		put(22, top_down ? 0U - height : height, 4);
+		put(26, 1, 2);
+		put(28, layout.bpp, 2);
+		put(30, layout.compression, 4);
+		i = 0;
+		while (i < masks / 4)
+		{
+			put(BMP_HSIZE + DIB_HSIZE + i * 4, layout.masks[i], 4);
+			++i;
+		}
+		i = 0;
+		while (i < colors)
+		{
+			palette.push_back(next() | 0xFF000000);
+			put(BMP_HSIZE + DIB_HSIZE + masks + i * 4, palette[i] & 0xFFFFFF, 4);
+			++i;
+		}
+		expected.resize((size_t)width * height * 4);
+		if (layout.compression == BI_RLE8 || layout.compression == BI_RLE4)
+			rle();
+		else
+			rows(top_down);
+		put(2, file.size(), 4);
+		put(34, file.size() - offset, 4);
+	}
+
+private:
+	BmpLayout const &			layout;
+	uint32_t const				width;
+	uint32_t const				height;
+	uint32_t					state;
+	uint32_t					run;
+	uint32_t					value;
+	/* 0xAARRGGBB */
+	std::vector<uint32_t>		palette;
+
+	uint32_t		next(void)
+	{
+		state = state * 1664525 + 1013904223;
+		return (state >> 8 ^ state << 16);
+	}
+
+	/* the next pixel: an index under colors, or 0xAARRGGBB */
+	uint32_t		pixel(uint32_t const &colors)
+	{
+		if (run == 0)
+		{
+			run = 1 + next() % 16;
+			value = colors ? next() % colors : next();
+		}
+		--run;
+		return (value);
+	}
+
+	void			put(size_t const &at, uint32_t const &v, int const &size)
+	{
+		int			i;
+
+		if (file.size() < at + size)
+			file.resize(at + size);
+		i = -1;
+		while (++i < size)
+			file[at + i] = (v >> (i * 8)) & 0xFF;
+	}
+
+	void			expect(uint32_t const &x, uint32_t const &y, uint32_t const &argb)
+	{
+		unsigned char * const	out = &expected[((size_t)y * width + x) * 4];
+
+		out[0] = argb >> 16;
+		out[1] = argb >> 8;
+		out[2] = argb;
+		out[3] = argb >> 24;
+	}
+
+	/* field of a masked channel holding an 8-bit value */
+	static uint32_t	field(uint32_t const &mask, uint32_t const &channel)
+	{
+		uint32_t	shift;
+		uint32_t	bits;
+
+		if (mask == 0)
+			return (0);
+		shift = 0;
+		while (!((mask >> shift) & 1))
+			shift++;
+		bits = 0;
+		while (bits < 32 && ((mask >> shift) >> bits) != 0)
+			bits++;
+		if (bits > 8)
+			return ((channel << (bits - 8)) << shift);
+		return ((channel >> (8 - bits)) << shift);
+	}
+
+	void			rows(bool const &top_down)
+	{
+		size_t const	row_size = ((size_t)width * layout.bpp + 31) / 32 * 4;
+		size_t const	start = file.size();
+		uint32_t const	r555[4] = { 0x7C00, 0x03E0, 0x001F, 0 };
+		uint32_t const	*masks = layout.compression == BI_RGB ? r555 : layout.masks;
+		unsigned char	*row;
+		uint32_t		argb;
+		uint32_t		v;
+		uint32_t		x;
+		uint32_t		y;
+
+		file.resize(start + row_size * height);
+		y = 0;
+		while (y < height)
+		{
+			row = &file[start + row_size * (top_down ? height - 1 - y : y)];
+			x = 0;
+			while (x < width)
+			{
+				argb = pixel(layout.bpp <= 8 ? 1U << layout.bpp : 0);
+				if (layout.bpp <= 8)
+				{
+					row[x * layout.bpp / 8] |= argb << (8 - layout.bpp - x * layout.bpp % 8);
+					argb = palette[argb];
+				}
+				else if (layout.bpp == 24)
+				{
+					row[x * 3] = argb;
+					row[x * 3 + 1] = argb >> 8;
+					row[x * 3 + 2] = argb >> 16;
+					argb |= 0xFF000000;
+				}
+				else
+				{
+					v = field(masks[0], (argb >> 16) & 0xFF) | field(masks[1], (argb >> 8) & 0xFF)
+						| field(masks[2], argb & 0xFF) | field(masks[3], argb >> 24);
+					std::memcpy(row + x * (layout.bpp / 8), &v, layout.bpp / 8);
+					if (masks[3] == 0)
+						argb |= 0xFF000000;
+				}
+				expect(x, y, argb);
+				++x;
+			}
+			++y;
+		}
+	}
+
+	/*
+	** Runs of two or more pixels are encoded runs, three or more single
+	** pixels an absolute run, the rest runs of one.
+	*/
+	void			rle(void)
+	{
+		bool const		rle4 = layout.compression == BI_RLE4;
+		uint32_t const	limit = rle4 ? 254 : 255;
+		std::vector<uint32_t>	line(width);
+		uint32_t		n;
+		uint32_t		i;
+		uint32_t		x;
+		uint32_t		y;
+
+		y = 0;
+		while (y < height)
+		{
+			x = 0;
+			while (x < width)
+			{
+				line[x] = pixel(1U << layout.bpp);
+				expect(x, y, palette[line[x]]);
+				++x;
+			}
+			x = 0;
+			while (x < width)
+			{
+				n = 1;
+				while (x + n < width && n < limit && line[x + n] == line[x])
+					++n;
+				if (n >= 2)
+				{
+					file.push_back(n);
+					file.push_back(rle4 ? line[x] << 4 | line[x] : line[x]);
+					x += n;
+					continue ;
+				}
+				while (x + n < width && n < limit && line[x + n] != line[x + n - 1])
+					++n;
+				if (n < 3)
+				{
+					file.push_back(1);
+					file.push_back(rle4 ? line[x] << 4 : line[x]);
+					++x;
+					continue ;
+				}
+				file.push_back(0);
+				file.push_back(n);
+				i = 0;
+				while (i < n)
+				{
+					if (!rle4)
+						file.push_back(line[x + i]);
+					else if (i % 2 == 0)
+						file.push_back(line[x + i] << 4);
+					else
+						file.back() |= line[x + i];
+					++i;
+				}
+				if (file.size() % 2)
+					file.push_back(0);
+				x += n;
+			}
+			file.push_back(0);
+			file.push_back(y + 1 < height ? 0 : 1);
+			++y;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "BmpSamples.hpp"
+#include "Bench.hpp"
+
+#define SIDE					(2048)
+
+/*
+** Bmp::writeData throughput on a SIDE x SIDE image of each layout. The
+** file is already in memory, so this is decoding alone.
+*/
+int
+main(void)
+{
+	Bmp					bmp;
+	unsigned char		*bytes;
+	double				ms;
+	size_t				i;
+
+	std::cout << SIDE << " x " << SIDE << " pixels" << std::endl;
+	i = 0;
+	while (i < BMP_LAYOUTS)
+	{
+		BmpSample		sample(bmpLayouts[i], SIDE, SIDE, i + 1);
+
+		bytes = new unsigned char[sample.file.size()];
+		std::memcpy(bytes, sample.file.data(), sample.file.size());
+		if (!bmp.openBuffer(bytes, sample.file.size()))
+			return (1);
+		ms = benchRun([&]() { bmp.writeData(0, bmp.height); benchKeep(bmp.data); });
+		if (bmpLayouts[i].lossless
+			&& std::memcmp(bmp.data, sample.expected.data(), sample.expected.size()) != 0)
+		{
+			std::cerr << bmpLayouts[i].name << ": wrong pixels" << std::endl;
+			return (1);
+		}
+		bmp.closeFile();
+		std::cout << std::left << std::setw(32) << bmpLayouts[i].name << std::right
+			<< std::fixed << std::setprecision(2) << std::setw(10) << ms << " ms"
+			<< std::setw(10) << (double)SIDE * SIDE / ms / 1000 << " Mpixel/s" << std::endl;
+		++i;
+	}
+	return (0);
+}
@@ -0,0 +1,85 @@
+#include <vector>
+#include "Mat4.hpp"
+#include "Bench.hpp"
+
+#define MATRICES				(1024)
+#define ITERATIONS				(10000)
+
+/*
+** Mat4<float>::operator* against the triple loop it replaced, on a
+** chain of products so each one depends on the previous result.
+*/
+
+static Mat4<float>
+loopMultiply(Mat4<float> const &lhs, Mat4<float> const &rhs)
+{
+	Mat4<float>	res;
+	int			i;
+	int			j;
+	int			k;
+
+	i = 0;
+	while (i < 4)
+	{
+		j = 0;
+		while (j < 4)
+		{
+			res.val[j * 4 + i] = 0.0f;
+			k = 0;
+			while (k < 4)
+			{
+				res.val[j * 4 + i] += lhs.val[k * 4 + i] * rhs.val[j * 4 + k];
+				k++;
+			}
+			j++;
+		}
+		i++;
+	}
+	return (res);
+}
+
+template<typename F>
+static double
+chain(std::vector<Mat4<float> > const &mats, F const &multiply)
+{
+	return (benchRun([&]()
+	{
+		Mat4<float>		acc;
+		int				n;
+		size_t			i;
+
+		n = 0;
+		while (n < ITERATIONS)
+		{
+			acc.setIdentity();
+			i = 0;
+			while (i < mats.size())
+				acc = multiply(acc, mats[i++]);
+			benchKeep(acc.val);
+			++n;
+		}
+	}));
+}
+
+int
+main(void)
+{
+	std::vector<Mat4<float> >	mats(MATRICES);
+	double						loop;
+	size_t						i;
+
+	i = 0;
+	while (i < mats.size())
+	{
+		mats[i].setIdentity();
+		mats[i].rotate(0.001f * i, 0.0f, 1.0f, 0.0f);
+		mats[i].translate(0.01f, 0.0f, -0.01f);
+		++i;
+	}
+	std::cout << MATRICES << " products x " << ITERATIONS << std::endl;
+	loop = chain(mats, loopMultiply);
+	benchReport("scalar loop", loop);
+	benchReport("Mat4<float>::operator*", chain(mats, [](Mat4<float> const &a,
+		Mat4<float> const &b) { return (a * b); }), loop);
+	return (0);
+}
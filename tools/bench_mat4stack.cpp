@@ -0,0 +1,84 @@
+#include <stack>
+#include "Mat4Stack.hpp"
+#include "Bench.hpp"
+
+#define ITERATIONS				(1000000)
+
+/*
+** Mat4Stack against the std::stack version it replaced, on the
+** push/translate/push/translate/pop/pop pattern of Core::render.
+*/
+
+template<typename T>
+class DequeStack
+{
+public:
+	std::stack<Mat4<T> >		stack;
+
+	DequeStack(void)
+	{
+		Mat4<T>		mat;
+
+		mat.setIdentity();
+		stack.push(mat);
+	}
+
+	void			push(void)
+	{
+		Mat4<T>		mat;
+
+		mat = stack.top();
+		stack.push(mat);
+	}
+
+	void			pop(void)
+	{
+		stack.pop();
+	}
+
+	Mat4<T> &		top(void)
+	{
+		return (stack.top());
+	}
+
+	void			translate(T const &x, T const &y, T const &z)
+	{
+		stack.top().translate(x, y, z);
+	}
+};
+
+template<typename STACK>
+static double
+render(void)
+{
+	return (benchRun([]()
+	{
+		STACK		stack;
+		int			n;
+
+		n = 0;
+		while (n < ITERATIONS)
+		{
+			stack.push();
+			stack.translate(1.0f, 0.0f, 0.0f);
+			stack.push();
+			stack.translate(0.0f, 1.0f, 0.0f);
+			benchKeep(stack.top().val);
+			stack.pop();
+			stack.pop();
+			++n;
+		}
+	}));
+}
+
+int
+main(void)
+{
+	double		deque;
+
+	std::cout << ITERATIONS << " x push/translate/push/translate/pop/pop" << std::endl;
+	deque = render<DequeStack<float> >();
+	benchReport("std::stack", deque);
+	benchReport("Mat4Stack", render<Mat4Stack<float> >(), deque);
+	return (0);
+}
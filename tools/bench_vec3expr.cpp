@@ -0,0 +1,94 @@
+#include <vector>
+#include "Vec3Expr.hpp"
+#include "Bench.hpp"
+
+#define VECTORS					(1000000)
+#define ITERATIONS				(100)
+
+/*
+** p = p + v * dt - c over VECTORS positions: Vec3 operators building
+** temporaries, the Vec3Array expression, and the loop one would write by
+** hand over the same arrays. The last two should take the same time.
+*/
+
+static void
+handLoop(Vec3Array &p, Vec3Array const &v, Vec3<float> const &c, float const &dt)
+{
+	size_t		i;
+
+	i = 0;
+	while (i < p.size)
+	{
+		p.x[i] = p.x[i] + v.x[i] * dt - c.x;
+		++i;
+	}
+	i = 0;
+	while (i < p.size)
+	{
+		p.y[i] = p.y[i] + v.y[i] * dt - c.y;
+		++i;
+	}
+	i = 0;
+	while (i < p.size)
+	{
+		p.z[i] = p.z[i] + v.z[i] * dt - c.z;
+		++i;
+	}
+}
+
+int
+main(void)
+{
+	std::vector<Vec3<float> >	ps(VECTORS, Vec3<float>(1.0f, 2.0f, 3.0f));
+	std::vector<Vec3<float> >	vs(VECTORS, Vec3<float>(0.5f, -0.5f, 0.25f));
+	Vec3Array					p(VECTORS);
+	Vec3Array					v(VECTORS);
+	Vec3<float> const			c(0.001f, 0.002f, 0.003f);
+	float const					dt = 0.016f;
+	double						temporaries;
+
+	p.fill(Vec3<float>(1.0f, 2.0f, 3.0f));
+	v.fill(Vec3<float>(0.5f, -0.5f, 0.25f));
+	std::cout << VECTORS << " vectors x " << ITERATIONS << ", p = p + v * dt - c" << std::endl;
+	temporaries = benchRun([&]()
+	{
+		int			n;
+		size_t		i;
+
+		n = -1;
+		while (++n < ITERATIONS)
+		{
+			i = 0;
+			while (i < ps.size())
+			{
+				ps[i] = ps[i] + vs[i] * dt - c;
+				++i;
+			}
+			benchKeep(ps.data());
+		}
+	});
+	benchReport("Vec3 operators", temporaries);
+	benchReport("assign(lazy(...))", benchRun([&]()
+	{
+		int			n;
+
+		n = -1;
+		while (++n < ITERATIONS)
+		{
+			assign(p, lazy(p) + lazy(v) * dt - lazy(c));
+			benchKeep(p.x);
+		}
+	}), temporaries);
+	benchReport("hand-written loop", benchRun([&]()
+	{
+		int			n;
+
+		n = -1;
+		while (++n < ITERATIONS)
+		{
+			handLoop(p, v, c, dt);
+			benchKeep(p.x);
+		}
+	}), temporaries);
+	return (0);
+}
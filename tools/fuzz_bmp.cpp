@@ -0,0 +1,91 @@
+#include <cstdlib>
+#include "BmpSamples.hpp"
+
+#define ROUNDS					(20000)
+
+/*
+** Feeds Bmp generated files of every layout, intact then damaged: bytes
+** flipped, headers rewritten, files cut short. Built with the address
+** and undefined behavior sanitizers by make fuzz, so any read outside
+** the file or write outside data aborts. Intact lossless files must
+** decode to the generated pixels. An optional argument sets the seed.
+*/
+
+static uint32_t
+roll(uint32_t &state)
+{
+	state = state * 1664525 + 1013904223;
+	return (state >> 8);
+}
+
+static void
+damage(std::vector<unsigned char> &file, uint32_t &state)
+{
+	uint32_t		n;
+	uint32_t		at;
+
+	n = 1 + roll(state) % 8;
+	while (n-- > 0)
+	{
+		at = roll(state) % 4 == 0 ? roll(state) % (BMP_HSIZE + DIB_HSIZE + 16)
+			: roll(state) % file.size();
+		if (at < file.size())
+			file[at] = roll(state) % 3 == 0 ? 0xFF * (roll(state) & 1) : roll(state);
+	}
+	if (roll(state) % 4 == 0)
+		file.resize(roll(state) % (file.size() + 1));
+}
+
+static int
+decode(std::vector<unsigned char> const &file, unsigned char const *expected)
+{
+	Bmp				bmp;
+	unsigned char	*bytes;
+	int				ret;
+
+	bytes = new unsigned char[file.size()];
+	std::memcpy(bytes, file.data(), file.size());
+	if (!bmp.openBuffer(bytes, file.size()))
+		return (expected == 0);
+	ret = bmp.writeData(0, bmp.height);
+	if (expected != 0)
+		ret = ret && std::memcmp(bmp.data, expected, (size_t)bmp.width * bmp.height * 4) == 0;
+	bmp.closeFile();
+	return (ret || expected == 0);
+}
+
+int
+main(int argc, char **argv)
+{
+	uint32_t		state;
+	uint32_t		round;
+	uint32_t		layout;
+	bool			top_down;
+	std::streambuf	*err;
+
+	state = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 42;
+	err = std::cerr.rdbuf(NULL);
+	round = 0;
+	while (round < ROUNDS)
+	{
+		layout = roll(state) % BMP_LAYOUTS;
+		top_down = bmpLayouts[layout].compression != BI_RLE8
+			&& bmpLayouts[layout].compression != BI_RLE4 && roll(state) % 2;
+		BmpSample	sample(bmpLayouts[layout], 1 + roll(state) % 64, 1 + roll(state) % 64,
+						roll(state), top_down);
+
+		if (!decode(sample.file, bmpLayouts[layout].lossless ? sample.expected.data() : 0))
+		{
+			std::cerr.rdbuf(err);
+			std::cerr << "round " << round << ": " << bmpLayouts[layout].name
+				<< " decoded wrong" << std::endl;
+			return (1);
+		}
+		damage(sample.file, state);
+		decode(sample.file, 0);
+		++round;
+	}
+	std::cerr.rdbuf(err);
+	std::cout << ROUNDS << " files, intact and damaged, decoded" << std::endl;
+	return (0);
+}
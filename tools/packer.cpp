@@ -0,0 +1,63 @@
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "Pack.hpp"
+
+/*
+** Directories are packed recursively, each file under the path it is
+** opened by at run time, so run it from the directory the game runs in:
+**
+**	./packer -z data.pak shaders textures
+*/
+static int
+collect(std::string const &path, std::vector<std::string> &files)
+{
+	struct stat		st;
+	struct dirent	*ent;
+	DIR				*dir;
+	int				ret;
+
+	if (stat(path.c_str(), &st) == -1)
+		return (std::cerr << "Cannot stat " << path << std::endl, 0);
+	if (!S_ISDIR(st.st_mode))
+		return (files.push_back(path), 1);
+	if ((dir = opendir(path.c_str())) == NULL)
+		return (std::cerr << "Cannot open " << path << std::endl, 0);
+	ret = 1;
+	while (ret && (ent = readdir(dir)) != NULL)
+	{
+		if (std::strcmp(ent->d_name, ".") != 0 && std::strcmp(ent->d_name, "..") != 0)
+			ret = collect(path + "/" + ent->d_name, files);
+	}
+	closedir(dir);
+	return (ret);
+}
+
+int
+main(int argc, char **argv)
+{
+	std::vector<std::string>	files;
+	bool						compress;
+	int							i;
+
+	compress = argc > 1 && std::strcmp(argv[1], "-z") == 0;
+	i = compress ? 2 : 1;
+	if (argc - i < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " [-z] pack file|directory ..." << std::endl;
+		return (1);
+	}
+	while (++i < argc)
+	{
+		if (!collect(argv[i], files))
+			return (1);
+	}
+	i = compress ? 2 : 1;
+	if (!Pack::build(argv[i], files, compress))
+		return (1);
+	std::cout << argv[i] << ": " << files.size() << " files" << std::endl;
+	return (0);
+}